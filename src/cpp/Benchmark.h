@@ -0,0 +1,30 @@
+#pragma once
+#include <chrono>
+#include <cstdio>
+#include <string>
+
+// Helpers for the --bench-* modes of the executable
+namespace benchmark {
+	// Average milliseconds per call, over enough calls to last a moment
+	template<typename Function>
+	double time_ms(Function &&function) {
+		using clock = std::chrono::steady_clock;
+		function(); // Warm up caches
+
+		size_t calls = 0;
+		const clock::time_point start = clock::now();
+		clock::duration elapsed{};
+		do {
+			function();
+			++calls;
+			elapsed = clock::now() - start;
+		} while (elapsed < std::chrono::milliseconds(250));
+		return std::chrono::duration<double, std::milli>(elapsed).count() / static_cast<double>(calls);
+	}
+
+	inline std::string format(const char *format, const double value) {
+		char buffer[32];
+		std::snprintf(buffer, sizeof(buffer), format, value);
+		return buffer;
+	}
+}
@@ -1,178 +1,540 @@
 #include "BlackBoard.h"
 
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
 #include <stdexcept>
-#include <bits/unique_ptr.h>
+#include <string>
 #include <glm/common.hpp>
 #include <glm/glm.hpp>
+#include <unistd.h>
+
+#include "Benchmark.h"
+#include "Utf8.h"
+#include "text_formatting.h"
+
+namespace {
+	void append_utf8(std::string &out, const char32_t code_point) {
+		if (code_point < 0x80) {
+			out += static_cast<char>(code_point);
+		} else if (code_point < 0x800) {
+			out += static_cast<char>(0xC0 | code_point >> 6);
+			out += static_cast<char>(0x80 | (code_point & 0x3F));
+		} else if (code_point < 0x10000) {
+			out += static_cast<char>(0xE0 | code_point >> 12);
+			out += static_cast<char>(0x80 | (code_point >> 6 & 0x3F));
+			out += static_cast<char>(0x80 | (code_point & 0x3F));
+		} else {
+			out += static_cast<char>(0xF0 | code_point >> 18);
+			out += static_cast<char>(0x80 | (code_point >> 12 & 0x3F));
+			out += static_cast<char>(0x80 | (code_point >> 6 & 0x3F));
+			out += static_cast<char>(0x80 | (code_point & 0x3F));
+		}
+	}
+
+	void append_number(std::string &out, const uint32_t number) {
+		if (number >= 100) out += static_cast<char>('0' + number / 100);
+		if (number >= 10) out += static_cast<char>('0' + number / 10 % 10);
+		out += static_cast<char>('0' + number % 10);
+	}
+
+	// Parameters of an SGR sequence setting a color, base 38 for the foreground and 48 for the background
+	void append_color(std::string &out, const uint32_t base, const uint32_t color) {
+		if (color == BlackBoard::DEFAULT_COLOR) {
+			append_number(out, base + 1);
+			return;
+		}
+		append_number(out, base);
+		out += ";2;";
+		append_number(out, color >> 16 & 0xFF);
+		out += ';';
+		append_number(out, color >> 8 & 0xFF);
+		out += ';';
+		append_number(out, color & 0xFF);
+	}
+}
 
 BlackBoard::BlackBoard(
 	const unsigned long _width,
 	const unsigned long _height
 ):
-	board(_height == -1UL ? 0 : _height),
 	width(_width),
 	height(_height)
 {
+	if (width == UNBOUNDED) throw std::invalid_argument("BlackBoard needs a fixed width");
+	clear();
+}
 
+// SGR sequence switching from the current style to the next one. Attributes can only be turned off all at once,
+// colors are set on their own while the attributes stay.
+void BlackBoard::append_style(std::string &out, const Style &current, const Style &next) {
+	const bool reset = next.attributes != current.attributes;
+	out += "\x1b[";
+	if (reset) {
+		out += '0';
+		if (next.attributes & BOLD) out += ";1";
+		if (next.attributes & DIM) out += ";2";
+		if (next.attributes & ITALIC) out += ";3";
+		if (next.attributes & UNDERLINE) out += ";4";
+		if (next.attributes & INVERSE) out += ";7";
+	}
+
+	bool separate = reset;
+	const auto color = [&](const uint32_t base, const uint32_t from, const uint32_t to) {
+		if (reset ? to == DEFAULT_COLOR : to == from) return;
+		if (separate) out += ';';
+		append_color(out, base, to);
+		separate = true;
+	};
+	color(38, current.foreground, next.foreground);
+	color(48, current.background, next.background);
+	out += 'm';
 }
 
-void BlackBoard::flush() {
-	for (const auto& row : board) {
-		for (const auto&[character] : row) {
-			std::cout << character;
+bool BlackBoard::reach(const unsigned long x) {
+	if (x < rows) return true;
+	if (height != UNBOUNDED) return false;
+
+	rows = x + 1;
+	characters.resize(rows * width, U' ');
+	attributes.resize(rows * width, NONE);
+	foregrounds.resize(rows * width, DEFAULT_COLOR);
+	backgrounds.resize(rows * width, DEFAULT_COLOR);
+	return true;
+}
+
+void BlackBoard::clear() {
+	// Keeps the allocation, a board redrawn every frame never allocates again
+	rows = height == UNBOUNDED ? 0 : height;
+	characters.assign(rows * width, U' ');
+	attributes.assign(rows * width, NONE);
+	foregrounds.assign(rows * width, DEFAULT_COLOR);
+	backgrounds.assign(rows * width, DEFAULT_COLOR);
+}
+
+void BlackBoard::append_cells(const unsigned long x, const unsigned long begin, const unsigned long end, Style &current) {
+	const size_t row_start = x * width;
+	for (unsigned long y = begin; y < end; y++) {
+		const Style style = {attributes[row_start + y], foregrounds[row_start + y], backgrounds[row_start + y]};
+		if (style != current) {
+			append_style(output, current, style);
+			current = style;
+		}
+
+		// The terminal moves the cursor by the character's width, every cell has to come out one column wide
+		// unless it is a wide character followed by its continuation
+		const char32_t character = characters[row_start + y];
+		if (character == WIDE_CONTINUATION) {
+			if (y == 0 || utf8::width(characters[row_start + y - 1]) != 2) append_utf8(output, U' ');
+			continue;
+		}
+		const unsigned character_width = utf8::width(character);
+		const bool continued = y + 1 < width && characters[row_start + y + 1] == WIDE_CONTINUATION;
+		if (character_width == 1 || (character_width == 2 && continued)) {
+			append_utf8(output, character);
+		} else {
+			append_utf8(output, U' ');
+		}
+	}
+}
+
+void BlackBoard::append_redraw() {
+	// Back to the first line of what is shown, then every row; newlines scroll if the board grew
+	if (shown_rows) output += "\x1b[" + std::to_string(shown_rows) + "F";
+
+	Style current;
+	for (unsigned long x = 0; x < rows; x++) {
+		append_cells(x, 0, width, current);
+		// Back to the defaults before the newline, a background color would otherwise fill the rest of the line
+		if (current != Style{}) append_style(output, current, {});
+		current = {};
+		output += "\n";
+	}
+
+	// Rows left over from a taller board
+	if (shown_rows > rows) output += "\x1b[J";
+}
+
+void BlackBoard::append_changes() {
+	unsigned long cursor_row = rows;
+	Style current;
+
+	const auto changed = [&](const size_t cell) {
+		return characters[cell] != shown_characters[cell]
+			|| attributes[cell] != shown_attributes[cell]
+			|| foregrounds[cell] != shown_foregrounds[cell]
+			|| backgrounds[cell] != shown_backgrounds[cell];
+	};
+
+	for (unsigned long x = 0; x < rows; x++) {
+		const size_t row_start = x * width;
+		unsigned long y = 0;
+		while (y < width) {
+			if (!changed(row_start + y)) {
+				y++;
+				continue;
+			}
+
+			// One run until the next stretch of unchanged cells too long to just rewrite. A run starting on the right
+			// half of a wide character rewrites all of it.
+			unsigned long begin = y;
+			if (begin > 0 && characters[row_start + begin] == WIDE_CONTINUATION
+				&& utf8::width(characters[row_start + begin - 1]) == 2) begin--;
+			unsigned long last_changed = y;
+			for (y++; y < width && y - last_changed <= MAX_SKIPPED_GAP; y++) {
+				if (changed(row_start + y)) last_changed = y;
+			}
+			const unsigned long end = last_changed + 1;
+			y = end;
+
+			if (x < cursor_row) output += "\x1b[" + std::to_string(cursor_row - x) + "A";
+			if (x > cursor_row) output += "\x1b[" + std::to_string(x - cursor_row) + "B";
+			output += "\r";
+			if (begin) output += "\x1b[" + std::to_string(begin) + "C";
+			cursor_row = x;
+
+			append_cells(x, begin, end, current);
 		}
-		std::cout << "\n";
 	}
-	board.clear();
-	if (height != -1UL) board.resize(height);
 
-	for (auto& row : board) {
-		if (width != -1UL) row.resize(width);
+	if (current != Style{}) append_style(output, current, {});
+	if (cursor_row < rows) output += "\x1b[" + std::to_string(rows - cursor_row) + "B\r";
+}
+
+void BlackBoard::flush() {
+	output.clear();
+	if (rows != shown_rows) {
+		append_redraw();
+	} else {
+		append_changes();
 	}
+
+	// Whatever went through the console and the stream so far has to come first
+	wnd::flush();
+	std::cout.flush();
+	const char *data = output.data();
+	size_t left = output.size();
+	while (left) {
+		const ssize_t written = ::write(STDOUT_FILENO, data, left);
+		if (written < 0) {
+			if (errno == EINTR) continue;
+			throw std::runtime_error("Writing the board to the terminal failed");
+		}
+		data += written;
+		left -= static_cast<size_t>(written);
+	}
+	flushed_bytes = output.size();
+
+	// The drawn board becomes the shown one, and the old shown buffers the next board to draw
+	std::swap(characters, shown_characters);
+	std::swap(attributes, shown_attributes);
+	std::swap(foregrounds, shown_foregrounds);
+	std::swap(backgrounds, shown_backgrounds);
+	shown_rows = rows;
+	clear();
 }
 
-BlackBoard::Pixel & BlackBoard::operator[](const unsigned long x, const unsigned long y) {
-	if (x > height) throw std::out_of_range("Parameter X greater than height!");
-	if (y > width)  throw std::out_of_range("Parameter Y greater than width!");
+BlackBoard::Pixel BlackBoard::operator[](const unsigned long x, const unsigned long y) const {
+	if (x >= rows) throw std::out_of_range("Parameter X greater than height!");
+	if (y >= width)  throw std::out_of_range("Parameter Y greater than width!");
 
-	return board[x][y];
+	const size_t cell = x * width + y;
+	return {characters[cell], attributes[cell], foregrounds[cell], backgrounds[cell]};
 }
 
-BlackBoard::Pixel & BlackBoard::operator[](const glm::u64vec2& pos) {
+BlackBoard::Pixel BlackBoard::operator[](const glm::u64vec2& pos) const {
 	return operator[](pos.x, pos.y);
 }
 
 void BlackBoard::set(const glm::u64vec2 &pos, const Pixel &pixel) {
-	while (pos.x >= board.size()) board.emplace_back();
-	while (pos.y >= board[pos.x].size()) board[pos.x].emplace_back(Pixel{" "});
-	board[pos.x][pos.y] = pixel;
+	if (pos.y >= width || !reach(pos.x)) return;
+	const size_t cell = pos.x * width + pos.y;
+	characters[cell] = pixel.character;
+	attributes[cell] = pixel.attributes;
+	foregrounds[cell] = pixel.foreground;
+	backgrounds[cell] = pixel.background;
 }
 
-void BlackBoard::rectangle_frame(const glm::u64vec2 &a, const glm::u64vec2 &b, const Pixel& pixel) {
-	glm::u64vec2 pos = a;
+void BlackBoard::write(const glm::u64vec2 &pos, const std::u32string_view text, const uint8_t text_attributes) {
+	if (pos.y >= width || !reach(pos.x)) return;
+	const size_t count = std::min<size_t>(text.size(), width - pos.y);
+	std::copy_n(text.begin(), count, row(pos.x).begin() + pos.y);
+	std::fill_n(row_attributes(pos.x).begin() + pos.y, count, text_attributes);
+	std::fill_n(row_foregrounds(pos.x).begin() + pos.y, count, DEFAULT_COLOR);
+	std::fill_n(row_backgrounds(pos.x).begin() + pos.y, count, DEFAULT_COLOR);
+}
+
+void BlackBoard::write(const glm::u64vec2 &pos, const std::string_view text, const uint8_t text_attributes) {
+	if (pos.y >= width || !reach(pos.x)) return;
+	const size_t row_start = pos.x * width;
 
-	if (pos.x < b.x) {
-		while (pos.x < b.x) {
-			pos.x++;
-			set(pos, pixel);
+	unsigned long y = pos.y;
+	size_t offset = 0;
+	while (offset < text.size() && y < width) {
+		if ((text[offset] & 0xC0) == 0x80) {
+			offset++;
+			continue;
 		}
-	} else if (pos.x > b.x) {
-		while (pos.x > b.x) {
-			pos.x--;
-			set(pos, pixel);
+		const char32_t character = utf8::decode(text, offset);
+		const unsigned character_width = utf8::width(character);
+		if (character_width == 0) continue;
+		if (y + character_width > width) break;
+
+		for (unsigned i = 0; i < character_width; i++) {
+			characters[row_start + y + i] = i ? WIDE_CONTINUATION : character;
+			attributes[row_start + y + i] = text_attributes;
+			foregrounds[row_start + y + i] = DEFAULT_COLOR;
+			backgrounds[row_start + y + i] = DEFAULT_COLOR;
 		}
+		y += character_width;
 	}
+}
 
-	if (pos.y < b.y) {
-		while (pos.y < b.y) {
-			pos.y++;
-			set(pos, pixel);
-		}
-	} else if (pos.y > b.y) {
-		while (pos.y > b.y) {
-			pos.y--;
-			set(pos, pixel);
-		}
+std::span<char32_t> BlackBoard::row(const unsigned long x) {
+	if (!reach(x)) return {};
+	return {characters.data() + x * width, width};
+}
+
+std::span<uint8_t> BlackBoard::row_attributes(const unsigned long x) {
+	if (!reach(x)) return {};
+	return {attributes.data() + x * width, width};
+}
+
+std::span<uint32_t> BlackBoard::row_foregrounds(const unsigned long x) {
+	if (!reach(x)) return {};
+	return {foregrounds.data() + x * width, width};
+}
+
+std::span<uint32_t> BlackBoard::row_backgrounds(const unsigned long x) {
+	if (!reach(x)) return {};
+	return {backgrounds.data() + x * width, width};
+}
+
+std::span<const char32_t> BlackBoard::row(const unsigned long x) const {
+	if (x >= rows) return {};
+	return {characters.data() + x * width, width};
+}
+
+std::span<const uint8_t> BlackBoard::row_attributes(const unsigned long x) const {
+	if (x >= rows) return {};
+	return {attributes.data() + x * width, width};
+}
+
+std::span<const uint32_t> BlackBoard::row_foregrounds(const unsigned long x) const {
+	if (x >= rows) return {};
+	return {foregrounds.data() + x * width, width};
+}
+
+std::span<const uint32_t> BlackBoard::row_backgrounds(const unsigned long x) const {
+	if (x >= rows) return {};
+	return {backgrounds.data() + x * width, width};
+}
+
+void BlackBoard::fill_row(const unsigned long x, const unsigned long y_begin, unsigned long y_end, const Pixel &pixel) {
+	y_end = std::min(y_end, width);
+	if (y_begin >= y_end || !reach(x)) return;
+	std::fill(characters.begin() + x * width + y_begin, characters.begin() + x * width + y_end, pixel.character);
+	std::fill(attributes.begin() + x * width + y_begin, attributes.begin() + x * width + y_end, pixel.attributes);
+	std::fill(foregrounds.begin() + x * width + y_begin, foregrounds.begin() + x * width + y_end, pixel.foreground);
+	std::fill(backgrounds.begin() + x * width + y_begin, backgrounds.begin() + x * width + y_end, pixel.background);
+}
+
+void BlackBoard::fill_column(const unsigned long y, const unsigned long x_begin, unsigned long x_end, const Pixel &pixel) {
+	if (y >= width || x_begin >= x_end) return;
+	if (!reach(x_end - 1)) x_end = rows;
+	for (unsigned long x = x_begin; x < x_end; x++) {
+		characters[x * width + y] = pixel.character;
+		attributes[x * width + y] = pixel.attributes;
+		foregrounds[x * width + y] = pixel.foreground;
+		backgrounds[x * width + y] = pixel.background;
 	}
+}
 
-	if (pos.x < a.x) {
-		while (pos.x < a.x) {
-			pos.x++;
-			set(pos, pixel);
+void BlackBoard::line(const glm::u64vec2 &a, const glm::u64vec2 &b, const Pixel &pixel) {
+	if (a.x == b.x) return fill_row(a.x, std::min(a.y, b.y), std::max(a.y, b.y) + 1, pixel);
+	if (a.y == b.y) return fill_column(a.y, std::min(a.x, b.x), std::max(a.x, b.x) + 1, pixel);
+
+	// Bresenham, stepping whichever coordinates keep the error term smallest
+	auto x = static_cast<int64_t>(a.x);
+	auto y = static_cast<int64_t>(a.y);
+	const auto end_x = static_cast<int64_t>(b.x);
+	const auto end_y = static_cast<int64_t>(b.y);
+	const int64_t dx = std::abs(end_x - x);
+	const int64_t dy = -std::abs(end_y - y);
+	const int64_t step_x = x < end_x ? 1 : -1;
+	const int64_t step_y = y < end_y ? 1 : -1;
+	int64_t error = dx + dy;
+
+	reach(std::max(a.x, b.x)); // Grow once instead of row by row
+	while (true) {
+		set({static_cast<uint64_t>(x), static_cast<uint64_t>(y)}, pixel);
+		if (x == end_x && y == end_y) break;
+		const int64_t doubled = 2 * error;
+		if (doubled >= dy) {
+			error += dy;
+			x += step_x;
 		}
-	} else if (pos.x > a.x) {
-		while (pos.x > a.x) {
-			pos.x--;
-			set(pos, pixel);
+		if (doubled <= dx) {
+			error += dx;
+			y += step_y;
 		}
 	}
+}
 
-	if (pos.y < a.y) {
-		while (pos.y < a.y) {
-			pos.y++;
-			set(pos, pixel);
-		}
-	} else if (pos.y > a.y) {
-		while (pos.y > a.y) {
-			pos.y--;
-			set(pos, pixel);
+void BlackBoard::blit(
+	const BlackBoard &source,
+	const glm::u64vec2 &source_pos,
+	const glm::u64vec2 &size,
+	const glm::u64vec2 &destination
+) {
+	if (source_pos.x >= source.rows || source_pos.y >= source.width || destination.y >= width) return;
+	const unsigned long block_rows = std::min<unsigned long>(size.x, source.rows - source_pos.x);
+	const unsigned long block_columns = std::min<unsigned long>({size.y, source.width - source_pos.y, width - destination.y});
+	if (!block_rows || !block_columns) return;
+
+	// Rows go bottom up when copying downwards within the same board, so none is overwritten before it is read
+	const bool backwards = &source == this && destination.x > source_pos.x;
+	for (unsigned long i = 0; i < block_rows; i++) {
+		const unsigned long row_offset = backwards ? block_rows - 1 - i : i;
+		if (!reach(destination.x + row_offset)) {
+			if (backwards) continue;
+			break;
 		}
+
+		// After reach(), which may reallocate when source is this board
+		const size_t from = (source_pos.x + row_offset) * source.width + source_pos.y;
+		const size_t to = (destination.x + row_offset) * width + destination.y;
+		std::memmove(characters.data() + to, source.characters.data() + from, block_columns * sizeof(char32_t));
+		std::memmove(attributes.data() + to, source.attributes.data() + from, block_columns);
+		std::memmove(foregrounds.data() + to, source.foregrounds.data() + from, block_columns * sizeof(uint32_t));
+		std::memmove(backgrounds.data() + to, source.backgrounds.data() + from, block_columns * sizeof(uint32_t));
 	}
 }
 
+void BlackBoard::rectangle_frame(const glm::u64vec2 &a, const glm::u64vec2 &b, const Pixel& pixel) {
+	const glm::u64vec2 low = {std::min(a.x, b.x), std::min(a.y, b.y)};
+	const glm::u64vec2 high = {std::max(a.x, b.x), std::max(a.y, b.y)};
+
+	fill_row(low.x, low.y, high.y + 1, pixel);
+	fill_row(high.x, low.y, high.y + 1, pixel);
+	fill_column(low.y, low.x, high.x + 1, pixel);
+	fill_column(high.y, low.x, high.x + 1, pixel);
+}
+
 void BlackBoard::rectangle_filled(glm::u64vec2 a, glm::u64vec2 b, const Pixel &pixel) {
 	if (a.x > b.x) std::swap(a.x, b.x);
 	if (a.y > b.y) std::swap(a.y, b.y);
 
 	for (unsigned long i = a.x; i < b.x; i++) {
-		for (unsigned long j = a.y; j < b.y; j++) {
-			set({i, j}, pixel);
-		}
+		fill_row(i, a.y, b.y, pixel);
 	}
 }
 
-void BlackBoard::rectangle_nice_frame(const glm::u64vec2 &a, const glm::u64vec2 &b, bool bold) {
-	glm::u64vec2 pos = a;
+void BlackBoard::rectangle_nice_frame(const glm::u64vec2 &a, const glm::u64vec2 &b, const bool bold) {
+	const glm::u64vec2 low = {std::min(a.x, b.x), std::min(a.y, b.y)};
+	const glm::u64vec2 high = {std::max(a.x, b.x), std::max(a.y, b.y)};
 
-	Pixel pixel = {bold ? "┃" : "│"};
+	const Pixel horizontal = {bold ? U'━' : U'─'};
+	const Pixel vertical = {bold ? U'┃' : U'│'};
+	fill_row(a.x, low.y + 1, high.y, horizontal);
+	fill_row(b.x, low.y + 1, high.y, horizontal);
+	fill_column(a.y, low.x + 1, high.x, vertical);
+	fill_column(b.y, low.x + 1, high.x, vertical);
 
-	if (pos.x < b.x) {
-		while (pos.x < b.x) {
-			pos.x++;
-			set(pos, pixel);
-		}
-	} else if (pos.x > b.x) {
-		while (pos.x > b.x) {
-			pos.x--;
-			set(pos, pixel);
+	set(a, {bold ? U'┏' : U'┌'});
+	set({a.x, b.y}, {bold ? U'┓' : U'┐'});
+	set(b, {bold ? U'┛' : U'┘'});
+	set({b.x, a.y}, {bold ? U'┗' : U'└'});
+}
+
+
+
+namespace {
+	// How every shape was drawn before the span operations
+	void per_cell_filled(BlackBoard &board, const glm::u64vec2 &a, const glm::u64vec2 &b, const BlackBoard::Pixel &pixel) {
+		for (unsigned long i = a.x; i < b.x; i++) {
+			for (unsigned long j = a.y; j < b.y; j++) {
+				board.set({i, j}, pixel);
+			}
 		}
 	}
 
-	pixel = {bold ? "━" : "─"};
-
-	if (pos.y < b.y) {
-		while (pos.y < b.y) {
-			pos.y++;
-			set(pos, pixel);
+	void per_cell_frame(BlackBoard &board, const glm::u64vec2 &a, const glm::u64vec2 &b, const BlackBoard::Pixel &pixel) {
+		for (unsigned long i = a.x; i <= b.x; i++) {
+			board.set({i, a.y}, pixel);
+			board.set({i, b.y}, pixel);
 		}
-	} else if (pos.y > b.y) {
-		while (pos.y > b.y) {
-			pos.y--;
-			set(pos, pixel);
+		for (unsigned long j = a.y; j <= b.y; j++) {
+			board.set({a.x, j}, pixel);
+			board.set({b.x, j}, pixel);
 		}
 	}
 
-	pixel = {bold ? "┃" : "│"};
-
-	if (pos.x < a.x) {
-		while (pos.x < a.x) {
-			pos.x++;
-			set(pos, pixel);
-		}
-	} else if (pos.x > a.x) {
-		while (pos.x > a.x) {
-			pos.x--;
-			set(pos, pixel);
+	void per_cell_blit(BlackBoard &board, const BlackBoard &source) {
+		for (unsigned long i = 0; i < source.row_count(); i++) {
+			for (unsigned long j = 0; j < source.columns(); j++) {
+				board.set({i, j}, source[i, j]);
+			}
 		}
 	}
+}
 
-	pixel = {bold ? "━" : "─"};
+void benchmark_black_board(const unsigned long width, const unsigned long height) {
+	BlackBoard board{width, height};
+	BlackBoard source{width, height};
+	source.rectangle_filled({0, 0}, {height, width}, {U'▒', BlackBoard::DIM});
 
-	if (pos.y < a.y) {
-		while (pos.y < a.y) {
-			pos.y++;
-			set(pos, pixel);
-		}
-	} else if (pos.y > a.y) {
-		while (pos.y > a.y) {
-			pos.y--;
-			set(pos, pixel);
+	const auto frames = [&](const bool spans) {
+		for (unsigned long inset = 0; 2 * inset + 1 < std::min(width, height); inset += 2) {
+			const glm::u64vec2 a = {inset, inset};
+			const glm::u64vec2 b = {height - 1 - inset, width - 1 - inset};
+			if (spans) {
+				board.rectangle_frame(a, b, {U'#'});
+			} else {
+				per_cell_frame(board, a, b, {U'#'});
+			}
 		}
+	};
+
+	struct Case {
+		const char *name;
+		double per_cell_ms;
+		double span_ms;
+	};
+	const Case cases[] = {
+		{
+			"Filled board",
+			benchmark::time_ms([&] { per_cell_filled(board, {0, 0}, {height, width}, {U'█'}); }),
+			benchmark::time_ms([&] { board.rectangle_filled({0, 0}, {height, width}, {U'█'}); })
+		},
+		{
+			"Nested frames",
+			benchmark::time_ms([&] { frames(false); }),
+			benchmark::time_ms([&] { frames(true); })
+		},
+		{
+			"Board blit",
+			benchmark::time_ms([&] { per_cell_blit(board, source); }),
+			benchmark::time_ms([&] { board.blit(source, {0, 0}, {height, width}, {0, 0}); })
+		},
+	};
+
+	wnd::begin("BlackBoard benchmark", wnd::none, 64);
+	wnd::begin_section("Board: " + std::to_string(width) + " x " + std::to_string(height));
+	wnd::print(wnd::set_length("", 16) + wnd::set_length("Per cell", 14) + wnd::set_length("Spans", 14) + "Speedup");
+	for (const Case &test : cases) {
+		wnd::print(
+			wnd::set_length(test.name, 16)
+			+ wnd::set_length(benchmark::format("%.2f us", test.per_cell_ms * 1000.0), 14)
+			+ wnd::set_length(benchmark::format("%.2f us", test.span_ms * 1000.0), 14)
+			+ benchmark::format("%.1fx", test.per_cell_ms / test.span_ms)
+		);
 	}
 
-	set(a, {bold ? "┏" : "┌"});
-	set({a.x, b.y}, {bold ? "┓" : "┐"});
-	set(b, {bold ? "┛" : "┘"});
-	set({b.x, a.y}, {bold ? "┗" : "└"});
+	const unsigned long diagonal = std::max(width, height);
+	const double line_ms = benchmark::time_ms([&] { board.line({0, 0}, {height - 1, width - 1}, {U'*'}); });
+	wnd::print(wnd::set_length("Diagonal line", 16) + benchmark::format("%.1f ns/cell", line_ms * 1e6 / static_cast<double>(diagonal)));
+	wnd::end();
 }
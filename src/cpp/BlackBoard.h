@@ -1,32 +1,139 @@
 #pragma once
+#include <cstdint>
+#include <span>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <glm/glm.hpp>
 
+// Character grid to draw console output into before flushing it at once.
+// Cells are stored flat, row after row, as one code point, one attribute byte and a foreground and background color
+// each, so drawing is plain memory writes. Positions are (row, column). With UNBOUNDED height the board grows downwards as rows are drawn to,
+// writes outside the board are clipped.
+//
+// The board is double buffered: flush() compares against what the previous flush put on the terminal and only
+// rewrites the runs of cells that changed, moving the cursor relative to the line below the board. Anything else
+// printed in between throws that off, call invalidate() afterwards to draw the next flush in full.
 class BlackBoard {
 public:
+	static constexpr unsigned long UNBOUNDED = -1UL;
+
+	enum Attribute : uint8_t {
+		NONE = 0,
+		BOLD = 1 << 0,
+		DIM = 1 << 1,
+		ITALIC = 1 << 2,
+		UNDERLINE = 1 << 3,
+		INVERSE = 1 << 4,
+	};
+
+	// Right half of the wide character in the cell to its left
+	static constexpr char32_t WIDE_CONTINUATION = U'\0';
+
+	// Colors are 0xRRGGBB, printed as truecolor escapes. DEFAULT_COLOR leaves the terminal's own color.
+	static constexpr uint32_t DEFAULT_COLOR = UINT32_MAX;
+	static constexpr uint32_t rgb(const uint8_t r, const uint8_t g, const uint8_t b) {
+		return static_cast<uint32_t>(r) << 16 | static_cast<uint32_t>(g) << 8 | b;
+	}
+
 	struct Pixel {
-		std::string character;
+		char32_t character = U' ';
+		uint8_t attributes = NONE;
+		uint32_t foreground = DEFAULT_COLOR;
+		uint32_t background = DEFAULT_COLOR;
+
+		bool operator==(const Pixel &) const = default;
 	};
+
 private:
-	std::vector<std::vector<Pixel>> board;
+	std::vector<char32_t> characters;
+	std::vector<uint8_t> attributes;
+	std::vector<uint32_t> foregrounds;
+	std::vector<uint32_t> backgrounds;
 
 	unsigned long width;
 	unsigned long height;
+	unsigned long rows = 0; // Rows stored so far, equals height unless that is UNBOUNDED
+
+	// What the terminal shows since the last flush, the cursor is on the line below it
+	std::vector<char32_t> shown_characters;
+	std::vector<uint8_t> shown_attributes;
+	std::vector<uint32_t> shown_foregrounds;
+	std::vector<uint32_t> shown_backgrounds;
+	unsigned long shown_rows = 0;
+
+	std::string output; // Reused by every flush
+	size_t flushed_bytes = 0;
+
+	// Shorter stretches of unchanged cells are rewritten instead of skipped, a cursor move costs about as much
+	static constexpr unsigned long MAX_SKIPPED_GAP = 4;
+
+	// Makes sure row x is stored, false if it is past a fixed height
+	bool reach(unsigned long x);
+
+	// What the terminal draws the next character with
+	struct Style {
+		uint8_t attributes = NONE;
+		uint32_t foreground = DEFAULT_COLOR;
+		uint32_t background = DEFAULT_COLOR;
+
+		bool operator==(const Style &) const = default;
+	};
+
+	static void append_style(std::string &out, const Style &current, const Style &next);
+	// Appends cells [begin, end) of row x, switching the style from current as needed
+	void append_cells(unsigned long x, unsigned long begin, unsigned long end, Style &current);
+	void append_redraw();
+	void append_changes();
 
 public:
-	explicit BlackBoard(unsigned long _width = 128, unsigned long _height = -1);
-	BlackBoard(std::vector<std::vector<Pixel>>, unsigned long, unsigned long) = delete;
+	explicit BlackBoard(unsigned long _width = 128, unsigned long _height = UNBOUNDED);
 
+	// Prints what changed since the last flush with a single write() and clears the board
 	void flush();
+	void clear();
+	// Forgets what the terminal shows, the next flush draws every row below the cursor
+	void invalidate() { shown_rows = 0; }
+	[[nodiscard]] size_t last_flush_bytes() const { return flushed_bytes; }
 
-	Pixel& operator[](unsigned long x, unsigned long y);
-	Pixel& operator[](const glm::u64vec2& pos);
+	[[nodiscard]] unsigned long columns() const { return width; }
+	[[nodiscard]] unsigned long row_count() const { return rows; }
 
-	void set(const glm::u64vec2& pos, const Pixel& pixel = {" "});
+	// Throws for cells that are not stored
+	Pixel operator[](unsigned long x, unsigned long y) const;
+	Pixel operator[](const glm::u64vec2& pos) const;
+
+	void set(const glm::u64vec2& pos, const Pixel& pixel = {U' ', NONE, DEFAULT_COLOR, DEFAULT_COLOR});
+	// Text along the row starting at pos in the terminal's colors, clipped at the right edge. One code point per cell.
+	void write(const glm::u64vec2& pos, std::u32string_view text, uint8_t text_attributes = NONE);
+	// UTF-8 text by display width: wide characters take two cells, combining characters are dropped and a character
+	// that would not fit whole is left out
+	void write(const glm::u64vec2& pos, std::string_view text, uint8_t text_attributes = NONE);
+
+	// The cells of row x for drawing a whole span at once, stored on demand. Empty if x is past a fixed height.
+	[[nodiscard]] std::span<char32_t> row(unsigned long x);
+	[[nodiscard]] std::span<uint8_t> row_attributes(unsigned long x);
+	[[nodiscard]] std::span<uint32_t> row_foregrounds(unsigned long x);
+	[[nodiscard]] std::span<uint32_t> row_backgrounds(unsigned long x);
+	[[nodiscard]] std::span<const char32_t> row(unsigned long x) const;
+	[[nodiscard]] std::span<const uint8_t> row_attributes(unsigned long x) const;
+	[[nodiscard]] std::span<const uint32_t> row_foregrounds(unsigned long x) const;
+	[[nodiscard]] std::span<const uint32_t> row_backgrounds(unsigned long x) const;
+
+	// Cells [y_begin, y_end) of row x
+	void fill_row(unsigned long x, unsigned long y_begin, unsigned long y_end, const Pixel &pixel);
+	// Cells [x_begin, x_end) of column y
+	void fill_column(unsigned long y, unsigned long x_begin, unsigned long x_end, const Pixel &pixel);
+	// Every cell from a to b, both included
+	void line(const glm::u64vec2 &a, const glm::u64vec2 &b, const Pixel &pixel);
+	// Copies a size block of cells from source to destination, clipped to both boards. Source may be this board.
+	void blit(const BlackBoard &source, const glm::u64vec2 &source_pos, const glm::u64vec2 &size, const glm::u64vec2 &destination);
 
 	void rectangle_frame(const glm::u64vec2 & a, const glm::u64vec2 & b, const Pixel &pixel);
 	void rectangle_filled(glm::u64vec2 a, glm::u64vec2 b, const Pixel &pixel);
 
 	void rectangle_nice_frame(const glm::u64vec2 & a, const glm::u64vec2 & b, bool bold = false);
 };
+
+// Times the span based drawing against writing the same shapes cell by cell with set(). Prints to stdout.
+void benchmark_black_board(unsigned long width = 240, unsigned long height = 70);
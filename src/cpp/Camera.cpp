@@ -0,0 +1,43 @@
+#include "Camera.h"
+
+#include <cmath>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+glm::vec3 Camera::forward() const {
+	return {
+		-std::sin(yaw) * std::cos(pitch),
+		std::sin(pitch),
+		-std::cos(yaw) * std::cos(pitch)
+	};
+}
+
+glm::mat4 Camera::view() const {
+	return glm::lookAt(position, position + forward(), glm::vec3{0.0f, 1.0f, 0.0f});
+}
+
+glm::mat4 Camera::projection() const {
+	const float focal_length = 1.0f / std::tan(vertical_fov * 0.5f);
+
+	// clip.z = near and clip.w = -view.z, so depth = near / distance: 1 at the near plane, 0 at infinity
+	glm::mat4 projection{0.0f};
+	projection[0][0] = focal_length / aspect;
+	projection[1][1] = -focal_length;
+	projection[2][3] = -1.0f;
+	projection[3][2] = near_plane;
+	return projection;
+}
+
+glm::mat4 Camera::view_projection() const {
+	return projection() * view();
+}
+
+float Camera::view_depth(const glm::vec3 &point) const {
+	return glm::dot(point - position, forward());
+}
+
+void Camera::look_at(const glm::vec3 &target) {
+	const glm::vec3 direction = glm::normalize(target - position);
+	pitch = std::asin(direction.y);
+	yaw = std::atan2(-direction.x, -direction.z);
+}
@@ -0,0 +1,27 @@
+#pragma once
+#include <glm/glm.hpp>
+
+// Perspective camera for a reversed-Z depth buffer: depth is 1 at the near plane and falls towards 0 at infinity,
+// which spreads float precision evenly over distance. Clear depth to CLEAR_DEPTH and test with a greater compare.
+class Camera {
+public:
+	static constexpr float CLEAR_DEPTH = 0.0f;
+
+	glm::vec3 position{0.0f, 0.0f, 2.0f};
+	float yaw = 0.0f;   // Radians around +Y, 0 looks down -Z
+	float pitch = 0.0f; // Radians, positive looks up
+	float vertical_fov = glm::radians(60.0f);
+	float near_plane = 0.1f;
+	float aspect = 1.0f;
+
+	[[nodiscard]] glm::vec3 forward() const;
+	[[nodiscard]] glm::mat4 view() const;
+	// Infinite far plane, Vulkan clip space (y down, depth 0 to 1)
+	[[nodiscard]] glm::mat4 projection() const;
+	[[nodiscard]] glm::mat4 view_projection() const;
+
+	// Distance along the view direction, sort opaque draws by it ascending so early depth tests reject the most
+	[[nodiscard]] float view_depth(const glm::vec3 &point) const;
+
+	void look_at(const glm::vec3 &target);
+};
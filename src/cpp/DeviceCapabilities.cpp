@@ -0,0 +1,257 @@
+#include "DeviceCapabilities.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <type_traits>
+
+namespace {
+	constexpr uint32_t MAGIC = 0x4344434C; // "LCDC"
+	constexpr uint32_t VERSION = 1;
+
+	// Sizes of the structures as they are written, files from builds with other Vulkan headers are not read
+	constexpr std::array<uint32_t, 8> LAYOUT = {
+		sizeof(vk::PhysicalDeviceProperties),
+		sizeof(vk::PhysicalDeviceFeatures),
+		sizeof(vk::PhysicalDeviceVulkan11Features),
+		sizeof(vk::PhysicalDeviceVulkan12Features),
+		sizeof(vk::PhysicalDeviceVulkan13Features),
+		sizeof(vk::PhysicalDeviceMemoryProperties),
+		sizeof(vk::QueueFamilyProperties),
+		sizeof(vk::TimeDomainEXT),
+	};
+
+	class Writer {
+		std::string &out;
+
+	public:
+		explicit Writer(std::string &_out) : out(_out) {}
+
+		template<typename T>
+		void value(const T &value) {
+			static_assert(std::is_trivially_copyable_v<T>);
+			out.append(reinterpret_cast<const char *>(&value), sizeof(T));
+		}
+
+		void string(const std::string &string) {
+			value(static_cast<uint32_t>(string.size()));
+			out += string;
+		}
+
+		template<typename T>
+		void vector(const std::vector<T> &values) {
+			value(static_cast<uint32_t>(values.size()));
+			for (const T &element : values) {
+				if constexpr (std::is_same_v<T, std::string>) {
+					string(element);
+				} else {
+					value(element);
+				}
+			}
+		}
+	};
+
+	// Every read fails once one ran past the end
+	class Reader {
+		std::string_view in;
+		bool ok = true;
+
+	public:
+		explicit Reader(const std::string_view _in) : in(_in) {}
+
+		template<typename T>
+		bool value(T &value) {
+			static_assert(std::is_trivially_copyable_v<T>);
+			if (!ok || in.size() < sizeof(T)) return ok = false;
+			std::memcpy(&value, in.data(), sizeof(T));
+			in.remove_prefix(sizeof(T));
+			return true;
+		}
+
+		bool string(std::string &string) {
+			uint32_t size;
+			if (!value(size) || in.size() < size) return ok = false;
+			string.assign(in.substr(0, size));
+			in.remove_prefix(size);
+			return true;
+		}
+
+		template<typename T>
+		bool vector(std::vector<T> &values) {
+			uint32_t size;
+			if (!value(size) || in.size() < size) return ok = false; // Every element takes at least a byte
+			values.resize(size);
+			for (T &element : values) {
+				if constexpr (std::is_same_v<T, std::string>) {
+					string(element);
+				} else {
+					value(element);
+				}
+			}
+			return ok;
+		}
+
+		[[nodiscard]] bool good() const { return ok; }
+	};
+
+	void write(Writer &writer, const DeviceCapabilities &capabilities) {
+		writer.value(capabilities.properties);
+		writer.value(capabilities.features);
+		writer.value(capabilities.vulkan_11_features);
+		writer.value(capabilities.vulkan_12_features);
+		writer.value(capabilities.vulkan_13_features);
+		writer.value(capabilities.graphics_pipeline_library);
+		writer.value(capabilities.dynamic_blend_enable);
+		writer.vector(capabilities.extensions);
+		writer.value(capabilities.memory);
+		writer.vector(capabilities.queue_families);
+		writer.vector(capabilities.time_domains);
+	}
+
+	bool read(Reader &reader, DeviceCapabilities &capabilities) {
+		reader.value(capabilities.properties);
+		reader.value(capabilities.features);
+		reader.value(capabilities.vulkan_11_features);
+		reader.value(capabilities.vulkan_12_features);
+		reader.value(capabilities.vulkan_13_features);
+		reader.value(capabilities.graphics_pipeline_library);
+		reader.value(capabilities.dynamic_blend_enable);
+		reader.vector(capabilities.extensions);
+		reader.value(capabilities.memory);
+		reader.vector(capabilities.queue_families);
+		reader.vector(capabilities.time_domains);
+
+		// The pointers were only valid in the run that wrote them
+		capabilities.vulkan_11_features.pNext = nullptr;
+		capabilities.vulkan_12_features.pNext = nullptr;
+		capabilities.vulkan_13_features.pNext = nullptr;
+		return reader.good();
+	}
+
+	bool same_driver(const vk::PhysicalDeviceProperties &a, const vk::PhysicalDeviceProperties &b) {
+		return a.vendorID == b.vendorID
+			&& a.deviceID == b.deviceID
+			&& a.driverVersion == b.driverVersion
+			&& a.apiVersion == b.apiVersion
+			&& a.pipelineCacheUUID == b.pipelineCacheUUID;
+	}
+}
+
+bool DeviceCapabilities::has_extension(const std::string_view name) const {
+	return std::ranges::binary_search(extensions, name, std::less<>{});
+}
+
+DeviceCapabilities DeviceCapabilities::query(const raii::PhysicalDevice &device) {
+	DeviceCapabilities capabilities;
+	capabilities.properties = device.getProperties();
+	capabilities.features = device.getFeatures();
+
+	if (capabilities.properties.apiVersion >= vk::ApiVersion13) {
+		const auto chain = device.getFeatures2<
+			vk::PhysicalDeviceFeatures2,
+			vk::PhysicalDeviceVulkan11Features,
+			vk::PhysicalDeviceVulkan12Features,
+			vk::PhysicalDeviceVulkan13Features
+		>();
+		capabilities.vulkan_11_features = chain.get<vk::PhysicalDeviceVulkan11Features>();
+		capabilities.vulkan_12_features = chain.get<vk::PhysicalDeviceVulkan12Features>();
+		capabilities.vulkan_13_features = chain.get<vk::PhysicalDeviceVulkan13Features>();
+		capabilities.vulkan_11_features.pNext = nullptr;
+		capabilities.vulkan_12_features.pNext = nullptr;
+		capabilities.vulkan_13_features.pNext = nullptr;
+	}
+
+	for (const vk::ExtensionProperties &extension : device.enumerateDeviceExtensionProperties()) {
+		capabilities.extensions.emplace_back(extension.extensionName.data());
+	}
+	std::ranges::sort(capabilities.extensions);
+
+	// Feature structures of extensions may only be chained when the device has the extension
+	if (capabilities.has_extension(vk::EXTGraphicsPipelineLibraryExtensionName) &&
+		capabilities.has_extension(vk::KHRPipelineLibraryExtensionName)) {
+		capabilities.graphics_pipeline_library = device.getFeatures2<
+			vk::PhysicalDeviceFeatures2,
+			vk::PhysicalDeviceGraphicsPipelineLibraryFeaturesEXT
+		>().get<vk::PhysicalDeviceGraphicsPipelineLibraryFeaturesEXT>().graphicsPipelineLibrary;
+	}
+	if (capabilities.has_extension(vk::EXTExtendedDynamicState3ExtensionName)) {
+		capabilities.dynamic_blend_enable = device.getFeatures2<
+			vk::PhysicalDeviceFeatures2,
+			vk::PhysicalDeviceExtendedDynamicState3FeaturesEXT
+		>().get<vk::PhysicalDeviceExtendedDynamicState3FeaturesEXT>().extendedDynamicState3ColorBlendEnable;
+	}
+
+	capabilities.memory = device.getMemoryProperties();
+	capabilities.queue_families = device.getQueueFamilyProperties();
+	if (capabilities.has_extension(vk::EXTCalibratedTimestampsExtensionName)) {
+		capabilities.time_domains = device.getCalibrateableTimeDomainsEXT();
+	}
+	return capabilities;
+}
+
+
+
+DeviceCapabilityCache::DeviceCapabilityCache(std::string _path) : path(std::move(_path)) {
+	if (path.empty()) return;
+	std::ifstream file(path, std::ios::binary);
+	if (!file) return;
+	const std::string bytes{std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+
+	Reader reader{bytes};
+	uint32_t magic, version, count;
+	std::array<uint32_t, LAYOUT.size()> layout{};
+	if (!reader.value(magic) || magic != MAGIC) return;
+	if (!reader.value(version) || version != VERSION) return;
+	if (!reader.value(layout) || layout != LAYOUT) return;
+	if (!reader.value(count)) return;
+
+	// One at a time, a corrupted count runs out of bytes instead of allocating for it
+	for (uint32_t i = 0; i < count; i++) {
+		DeviceCapabilities entry;
+		if (!read(reader, entry)) {
+			entries.clear();
+			return;
+		}
+		entries.push_back(std::move(entry));
+	}
+}
+
+DeviceCapabilities DeviceCapabilityCache::get(const raii::PhysicalDevice &device) {
+	const vk::PhysicalDeviceProperties properties = device.getProperties();
+	const auto entry = std::ranges::find_if(entries, [&](const DeviceCapabilities &cached) {
+		return cached.properties.vendorID == properties.vendorID && cached.properties.deviceID == properties.deviceID;
+	});
+	if (entry != entries.end() && same_driver(entry->properties, properties)) {
+		hits++;
+		return *entry;
+	}
+
+	DeviceCapabilities capabilities = DeviceCapabilities::query(device);
+	if (entry != entries.end()) {
+		*entry = capabilities;
+	} else {
+		entries.push_back(capabilities);
+	}
+	changed = true;
+	return capabilities;
+}
+
+bool DeviceCapabilityCache::save() {
+	if (!changed || path.empty()) return true;
+
+	std::string bytes;
+	Writer writer{bytes};
+	writer.value(MAGIC);
+	writer.value(VERSION);
+	writer.value(LAYOUT);
+	writer.value(static_cast<uint32_t>(entries.size()));
+	for (const DeviceCapabilities &entry : entries) write(writer, entry);
+
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	if (!file.write(bytes.data(), static_cast<std::streamsize>(bytes.size()))) return false;
+	changed = false;
+	return true;
+}
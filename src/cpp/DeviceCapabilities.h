@@ -0,0 +1,50 @@
+#pragma once
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <vulkan/vulkan_raii.hpp>
+
+namespace raii = vk::raii;
+
+// Everything the renderer asks a physical device about, except what depends on the surface.
+// Queried once per device and passed to whatever needs it, instead of every step asking the driver again.
+struct DeviceCapabilities {
+	vk::PhysicalDeviceProperties properties;
+	vk::PhysicalDeviceFeatures features;
+	// Without pNext, all false on devices below Vulkan 1.3
+	vk::PhysicalDeviceVulkan11Features vulkan_11_features;
+	vk::PhysicalDeviceVulkan12Features vulkan_12_features;
+	vk::PhysicalDeviceVulkan13Features vulkan_13_features;
+	// The features of optional extensions the renderer uses, false without the extension
+	bool graphics_pipeline_library = false;
+	bool dynamic_blend_enable = false;
+	std::vector<std::string> extensions; // Sorted
+	vk::PhysicalDeviceMemoryProperties memory;
+	std::vector<vk::QueueFamilyProperties> queue_families;
+	std::vector<vk::TimeDomainEXT> time_domains; // Empty without VK_EXT_calibrated_timestamps
+
+	[[nodiscard]] bool has_extension(std::string_view name) const;
+
+	[[nodiscard]] static DeviceCapabilities query(const raii::PhysicalDevice &device);
+};
+
+// Snapshots from earlier runs, kept in a file. An entry is only used for the same device with the same driver and
+// pipeline cache UUID, anything else is queried again and replaces it.
+class DeviceCapabilityCache {
+	std::string path;
+	std::vector<DeviceCapabilities> entries;
+	bool changed = false;
+	size_t hits = 0;
+
+public:
+	// Starts empty if the file is missing or was written by a build with other Vulkan headers. No file for an empty path.
+	explicit DeviceCapabilityCache(std::string _path);
+
+	[[nodiscard]] DeviceCapabilities get(const raii::PhysicalDevice &device);
+	// Writes the file if an entry changed, returns false if that failed
+	bool save();
+
+	[[nodiscard]] size_t hit_count() const { return hits; }
+};
@@ -0,0 +1,37 @@
+#include "DynamicResolution.h"
+
+#include <algorithm>
+#include <cmath>
+
+DynamicResolution::DynamicResolution(const float _target_ms, const float _min_scale, const float _max_scale):
+	target_ms(_target_ms),
+	min_scale(_min_scale),
+	max_scale(_max_scale),
+	scale(_max_scale)
+{
+
+}
+
+void DynamicResolution::update(const float gpu_ms) {
+	// Smooth out single noisy frames, but still react within a handful of frames
+	smoothed_ms = smoothed_ms == 0.0f ? gpu_ms : smoothed_ms + (gpu_ms - smoothed_ms) * 0.25f;
+
+	// GPU time roughly follows the pixel count, which goes with the square of the per-axis scale
+	const float ideal = scale * std::sqrt(target_ms / std::max(smoothed_ms, 0.001f));
+
+	if (smoothed_ms > target_ms) {
+		scale = std::max(ideal, scale * 0.85f);
+	} else if (smoothed_ms < target_ms * 0.8f) {
+		// Only grow with clear headroom and slowly, so it does not oscillate around the budget
+		scale = std::min(ideal, scale * 1.02f);
+	}
+	scale = std::clamp(scale, min_scale, max_scale);
+}
+
+vk::Extent2D DynamicResolution::render_extent(const vk::Extent2D output) const {
+	const auto axis = [&](const uint32_t size) {
+		const auto scaled = static_cast<uint32_t>(static_cast<float>(size) * scale);
+		return std::clamp(scaled / GRANULARITY * GRANULARITY, std::min(GRANULARITY, size), size);
+	};
+	return {axis(output.width), axis(output.height)};
+}
@@ -0,0 +1,29 @@
+#pragma once
+#include <vulkan/vulkan.hpp>
+
+// Picks the fraction of the output resolution to render at so the measured GPU frame time stays within a budget.
+// Scales down quickly when over budget and creeps back up once there is headroom, so a spike costs a few frames
+// of sharpness instead of a dropped frame.
+class DynamicResolution {
+	float target_ms;
+	float min_scale;
+	float max_scale;
+	float scale;
+	float smoothed_ms = 0.0f;
+
+public:
+	// Render extents are multiples of this, keeps the extent from jittering by single pixels
+	static constexpr uint32_t GRANULARITY = 8;
+
+	explicit DynamicResolution(float _target_ms = 1000.0f / 60.0f, float _min_scale = 0.5f, float _max_scale = 1.0f);
+
+	void set_target(float _target_ms) { target_ms = _target_ms; }
+	// Feed the GPU time of every finished frame
+	void update(float gpu_ms);
+
+	// Scale applies per axis, within output
+	[[nodiscard]] vk::Extent2D render_extent(vk::Extent2D output) const;
+	[[nodiscard]] float current_scale() const { return scale; }
+	[[nodiscard]] float gpu_time() const { return smoothed_ms; }
+	[[nodiscard]] float target() const { return target_ms; }
+};
@@ -0,0 +1,124 @@
+#include "EntityWorld.h"
+
+#include <atomic>
+#include <mutex>
+#include <string>
+
+namespace {
+	std::mutex component_mutex;
+	std::array<size_t, EntityWorld::MAX_COMPONENTS> component_sizes{};
+	std::atomic<EntityWorld::ComponentId> component_count = 0;
+}
+
+EntityWorld::EntityWorld(JobSystem &_jobs):
+	jobs(_jobs)
+{
+
+}
+
+EntityWorld::ComponentId EntityWorld::register_component(const size_t size) {
+	std::lock_guard lock{component_mutex};
+	const ComponentId id = component_count;
+	if (id >= MAX_COMPONENTS) {
+		throw std::runtime_error("More than " + std::to_string(MAX_COMPONENTS) + " component types");
+	}
+	component_sizes[id] = size;
+	component_count = id + 1;
+	return id;
+}
+
+size_t EntityWorld::component_size(const ComponentId component) {
+	// Written before the id was handed out and never again
+	return component_sizes[component];
+}
+
+uint32_t EntityWorld::find_archetype(const Signature &signature) {
+	if (const auto found = archetype_of.find(signature); found != archetype_of.end()) return found->second;
+
+	Archetype &archetype = archetypes.emplace_back();
+	archetype.signature = signature;
+	archetype.column_of.fill(-1);
+	for (ComponentId component = 0; component < MAX_COMPONENTS; ++component) {
+		if (!signature.test(component)) continue;
+		archetype.column_of[component] = static_cast<int8_t>(archetype.columns.size());
+		archetype.columns.push_back({component, component_size(component), {}, {}});
+	}
+
+	const auto index = static_cast<uint32_t>(archetypes.size() - 1);
+	archetype_of.emplace(signature, index);
+	return index;
+}
+
+uint32_t EntityWorld::append_row(const uint32_t archetype, const Entity entity) {
+	Archetype &target = archetypes[archetype];
+	for (Column &column : target.columns) {
+		column.data.resize(column.data.size() + column.size);
+		column.changed.push_back(current_tick);
+	}
+	target.entities.push_back(entity);
+	++structure;
+	return static_cast<uint32_t>(target.entities.size() - 1);
+}
+
+void EntityWorld::remove_row(const uint32_t archetype, const uint32_t row) {
+	Archetype &source = archetypes[archetype];
+	const auto last = static_cast<uint32_t>(source.entities.size() - 1);
+
+	// Swap the last row into the gap, keeps the arrays dense
+	if (row != last) {
+		for (Column &column : source.columns) {
+			std::memcpy(column.data.data() + row * column.size, column.data.data() + last * column.size, column.size);
+			column.changed[row] = column.changed[last];
+		}
+		source.entities[row] = source.entities[last];
+		records[source.entities[row].index].row = row;
+	}
+
+	for (Column &column : source.columns) {
+		column.data.resize(column.data.size() - column.size);
+		column.changed.pop_back();
+	}
+	source.entities.pop_back();
+	++structure;
+}
+
+void EntityWorld::move_entity(const Entity entity, const Signature &signature) {
+	const Record from = record(entity);
+	const uint32_t archetype = find_archetype(signature);
+	const uint32_t row = append_row(archetype, entity);
+
+	// References only after find_archetype(), which may grow the archetype list
+	const Archetype &source = archetypes[from.archetype];
+	Archetype &target = archetypes[archetype];
+	for (Column &column : target.columns) {
+		const int8_t source_column = source.column_of[column.component];
+		if (source_column < 0) continue;
+		const Column &old = source.columns[source_column];
+		std::memcpy(column.data.data() + row * column.size, old.data.data() + from.row * column.size, column.size);
+		column.changed[row] = old.changed[from.row];
+	}
+
+	remove_row(from.archetype, from.row);
+	records[entity.index].archetype = archetype;
+	records[entity.index].row = row;
+}
+
+const EntityWorld::Record &EntityWorld::record(const Entity entity) const {
+	if (!alive(entity)) throw std::runtime_error("Entity " + std::to_string(entity.index) + " does not exist");
+	return records[entity.index];
+}
+
+void EntityWorld::destroy(const Entity entity) {
+	const Record &entity_record = record(entity);
+	remove_row(entity_record.archetype, entity_record.row);
+
+	records[entity.index].alive = false;
+	++records[entity.index].generation;
+	free_indices.push_back(entity.index);
+}
+
+bool EntityWorld::alive(const Entity entity) const {
+	return entity.index < records.size()
+		&& records[entity.index].alive
+		&& records[entity.index].generation == entity.generation;
+}
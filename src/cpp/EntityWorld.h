@@ -0,0 +1,245 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <bitset>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+#include "JobSystem.h"
+
+struct Entity {
+	uint32_t index = UINT32_MAX;
+	uint32_t generation = 0; // Tells a destroyed entity from a later one reusing its index
+
+	bool operator==(const Entity &) const = default;
+};
+
+// Archetype based entity component system. Entities with the same set of components share an archetype, which
+// keeps each component in one contiguous array, so systems stream through memory instead of chasing pointers.
+// Components are plain data (trivially copyable) and move between archetypes by memcpy.
+//
+// Every row also records the tick its components were last written at. Systems declare what they write by
+// taking components as non-const, so consumers such as the instance upload only look at rows changed since
+// the tick they last saw.
+class EntityWorld {
+public:
+	using ComponentId = uint32_t;
+	static constexpr ComponentId MAX_COMPONENTS = 32;
+	using Signature = std::bitset<MAX_COMPONENTS>;
+
+	// Rows per parallel job, small enough to spread a few thousand entities over every core
+	static constexpr size_t PARALLEL_GRAIN = 256;
+
+private:
+	struct Column {
+		ComponentId component;
+		size_t size;
+		std::vector<std::byte> data;
+		std::vector<uint32_t> changed; // Tick of the last write to each row
+	};
+
+	struct Archetype {
+		Signature signature;
+		std::vector<Column> columns;
+		std::array<int8_t, MAX_COMPONENTS> column_of; // -1 if the component is not part of it
+		std::vector<Entity> entities;                 // Entity in each row
+	};
+
+	struct Record {
+		uint32_t archetype = 0;
+		uint32_t row = 0;
+		uint32_t generation = 0;
+		bool alive = false;
+	};
+
+	JobSystem &jobs;
+	std::vector<Archetype> archetypes;
+	std::unordered_map<Signature, uint32_t> archetype_of;
+	std::vector<Record> records;
+	std::vector<uint32_t> free_indices;
+	uint32_t current_tick = 1;
+	uint64_t structure = 0;
+
+	static ComponentId register_component(size_t size);
+	static size_t component_size(ComponentId component);
+
+	uint32_t find_archetype(const Signature &signature);
+	// Appends a row with uninitialized components
+	uint32_t append_row(uint32_t archetype, Entity entity);
+	void remove_row(uint32_t archetype, uint32_t row);
+	// Moves the entity into the archetype with signature, copying the components both have
+	void move_entity(Entity entity, const Signature &signature);
+	[[nodiscard]] const Record &record(Entity entity) const;
+
+	template<typename T>
+	T *column(Archetype &archetype) {
+		return reinterpret_cast<T *>(archetype.columns[archetype.column_of[component_id<T>()]].data.data());
+	}
+
+	template<typename T>
+	void write(Archetype &archetype, const uint32_t row, const T &value) {
+		Column &column = archetype.columns[archetype.column_of[component_id<T>()]];
+		std::memcpy(column.data.data() + row * sizeof(T), &value, sizeof(T));
+		column.changed[row] = current_tick;
+	}
+
+	// Stamps rows of components taken as non-const
+	template<typename T>
+	void touch(Archetype &archetype, const size_t begin, const size_t end) {
+		if constexpr (!std::is_const_v<T>) {
+			Column &column = archetype.columns[archetype.column_of[component_id<T>()]];
+			std::fill(column.changed.begin() + begin, column.changed.begin() + end, current_tick);
+		}
+	}
+
+	template<typename... Components, typename Function>
+	void iterate(Archetype &archetype, const size_t begin, const size_t end, Function &function) {
+		(touch<Components>(archetype, begin, end), ...);
+		const std::tuple columns = {column<std::remove_const_t<Components>>(archetype)...};
+		std::apply([&](auto *... arrays) {
+			for (size_t row = begin; row < end; ++row) function(archetype.entities[row], arrays[row]...);
+		}, columns);
+	}
+
+public:
+	explicit EntityWorld(JobSystem &_jobs);
+
+	template<typename T>
+	static ComponentId component_id() {
+		static_assert(std::is_trivially_copyable_v<T> && !std::is_const_v<T>, "Components are plain data");
+		static_assert(alignof(T) <= alignof(std::max_align_t));
+		static const ComponentId id = register_component(sizeof(T));
+		return id;
+	}
+
+	template<typename... Components>
+	static Signature signature() {
+		Signature signature;
+		(signature.set(component_id<std::remove_const_t<Components>>()), ...);
+		return signature;
+	}
+
+	template<typename... Components>
+	Entity create(const Components &... components) {
+		const Signature components_signature = signature<Components...>();
+		if (components_signature.count() != sizeof...(Components)) throw std::runtime_error("Component listed twice");
+
+		Entity entity;
+		if (free_indices.empty()) {
+			entity.index = static_cast<uint32_t>(records.size());
+			records.emplace_back();
+		} else {
+			entity.index = free_indices.back();
+			free_indices.pop_back();
+		}
+		Record &entity_record = records[entity.index];
+		entity.generation = entity_record.generation;
+
+		const uint32_t archetype = find_archetype(components_signature);
+		const uint32_t row = append_row(archetype, entity);
+		(write(archetypes[archetype], row, components), ...);
+		entity_record = {archetype, row, entity.generation, true};
+		return entity;
+	}
+
+	void destroy(Entity entity);
+	[[nodiscard]] bool alive(Entity entity) const;
+
+	template<typename T>
+	[[nodiscard]] bool has(const Entity entity) const {
+		return archetypes[record(entity).archetype].signature.test(component_id<T>());
+	}
+
+	// Replaces the value if the entity has one already
+	template<typename T>
+	void add(const Entity entity, const T &component) {
+		if (!has<T>(entity)) move_entity(entity, archetypes[record(entity).archetype].signature | signature<T>());
+		set(entity, component);
+	}
+
+	template<typename T>
+	void remove(const Entity entity) {
+		if (has<T>(entity)) move_entity(entity, archetypes[record(entity).archetype].signature & ~signature<T>());
+	}
+
+	// Null if the entity does not have the component. Reading does not count as a change.
+	template<typename T>
+	[[nodiscard]] const T *get(const Entity entity) {
+		if (!has<T>(entity)) return nullptr;
+		const Record &entity_record = record(entity);
+		return column<T>(archetypes[entity_record.archetype]) + entity_record.row;
+	}
+
+	template<typename T>
+	void set(const Entity entity, const T &component) {
+		if (!has<T>(entity)) throw std::runtime_error("Entity does not have the component");
+		const Record &entity_record = record(entity);
+		write(archetypes[entity_record.archetype], entity_record.row, component);
+	}
+
+	// Calls function(Entity, Components &...) for every entity that has all Components.
+	// Components taken as non-const are marked changed, so take what is only read as const.
+	template<typename... Components, typename Function>
+	void each(Function &&function) {
+		const Signature required = signature<Components...>();
+		for (Archetype &archetype : archetypes) {
+			if ((archetype.signature & required) != required) continue;
+			iterate<Components...>(archetype, 0, archetype.entities.size(), function);
+		}
+	}
+
+	// Like each(), spread over the job system's threads. The function may run on several threads at once and
+	// must not create, destroy or restructure entities.
+	template<typename... Components, typename Function>
+	void parallel_each(Function &&function) {
+		const Signature required = signature<Components...>();
+		for (Archetype &archetype : archetypes) {
+			if ((archetype.signature & required) != required) continue;
+			jobs.parallel_for(archetype.entities.size(), PARALLEL_GRAIN, [&](const size_t begin, const size_t end) {
+				iterate<Components...>(archetype, begin, end, function);
+			});
+		}
+	}
+
+	// Number of entities having all Components
+	template<typename... Components>
+	[[nodiscard]] size_t count() const {
+		const Signature required = signature<Components...>();
+		size_t total = 0;
+		for (const Archetype &archetype : archetypes) {
+			if ((archetype.signature & required) == required) total += archetype.entities.size();
+		}
+		return total;
+	}
+
+	// Calls function(std::span<const T> values, std::span<const uint32_t> changed_ticks) once per archetype with
+	// a T. The order of archetypes and rows only changes along with structure_version().
+	template<typename T, typename Function>
+	void chunks(Function &&function) const {
+		const ComponentId component = component_id<T>();
+		for (const Archetype &archetype : archetypes) {
+			if (!archetype.signature.test(component) || archetype.entities.empty()) continue;
+			const Column &column = archetype.columns[archetype.column_of[component]];
+			function(
+				std::span{reinterpret_cast<const T *>(column.data.data()), archetype.entities.size()},
+				std::span<const uint32_t>{column.changed}
+			);
+		}
+	}
+
+	// Writes are stamped with the current tick, advance it once per frame after consumers have synced
+	[[nodiscard]] uint32_t tick() const { return current_tick; }
+	void advance_tick() { ++current_tick; }
+	// Bumped whenever entities are created, destroyed or change archetype, which moves rows around
+	[[nodiscard]] uint64_t structure_version() const { return structure; }
+
+	[[nodiscard]] size_t entity_count() const { return records.size() - free_indices.size(); }
+	[[nodiscard]] size_t archetype_count() const { return archetypes.size(); }
+};
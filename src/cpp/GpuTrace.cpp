@@ -0,0 +1,109 @@
+#include "GpuTrace.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+GpuTrace::GpuTrace(
+	const raii::Device &_device,
+	const DeviceCapabilities &capabilities,
+	const uint32_t queue_family,
+	const bool calibration_enabled
+) : device(_device), track(trace::create_track("GPU")) {
+	const uint32_t valid_bits = capabilities.queue_families[queue_family].timestampValidBits;
+	if (!valid_bits) return;
+
+	queries = raii::QueryPool{device, vk::QueryPoolCreateInfo{{}, vk::QueryType::eTimestamp, 2 * MAX_ZONES}};
+	period = capabilities.properties.limits.timestampPeriod;
+	mask = valid_bits >= 64 ? ~0ull : (1ull << valid_bits) - 1;
+	calibrated = calibration_enabled && calibration_supported(capabilities);
+	zones.reserve(MAX_ZONES);
+}
+
+bool GpuTrace::calibration_supported(const DeviceCapabilities &capabilities) {
+#ifdef __linux__
+	// The trace clock is steady_clock, which is CLOCK_MONOTONIC
+	const std::vector<vk::TimeDomainEXT> &domains = capabilities.time_domains;
+	return std::ranges::find(domains, vk::TimeDomainEXT::eDevice) != domains.end() &&
+		std::ranges::find(domains, vk::TimeDomainEXT::eClockMonotonic) != domains.end();
+#else
+	return false;
+#endif
+}
+
+trace::Time GpuTrace::calibrate(uint64_t &device_ticks) const {
+	const std::array<vk::CalibratedTimestampInfoEXT, 2> domains = {{
+		{vk::TimeDomainEXT::eDevice},
+		{vk::TimeDomainEXT::eClockMonotonic},
+	}};
+	const auto [timestamps, max_deviation] = device.getCalibratedTimestampsEXT(domains);
+	device_ticks = timestamps[0] & mask;
+	return static_cast<trace::Time>(timestamps[1]);
+}
+
+void GpuTrace::begin_frame(const raii::CommandBuffer &command_buffer) {
+	zones.clear();
+	open.clear();
+	recording = *queries && trace::enabled();
+	if (recording) command_buffer.resetQueryPool(*queries, 0, 2 * MAX_ZONES);
+}
+
+void GpuTrace::begin(const raii::CommandBuffer &command_buffer, const std::string &name) {
+	if (!recording) return;
+	if (zones.size() >= MAX_ZONES) {
+		open.push_back(UINT32_MAX);
+		return;
+	}
+
+	const auto zone = static_cast<uint32_t>(zones.size());
+	zones.push_back(trace::intern(name));
+	open.push_back(zone);
+	command_buffer.writeTimestamp2(vk::PipelineStageFlagBits2::eTopOfPipe, *queries, 2 * zone);
+}
+
+void GpuTrace::end(const raii::CommandBuffer &command_buffer) {
+	if (!recording || open.empty()) return;
+	const uint32_t zone = open.back();
+	open.pop_back();
+	if (zone != UINT32_MAX) command_buffer.writeTimestamp2(vk::PipelineStageFlagBits2::eBottomOfPipe, *queries, 2 * zone + 1);
+}
+
+void GpuTrace::collect(const trace::Time fence_passed) {
+	if (!recording || zones.empty() || !open.empty()) return;
+	recording = false;
+
+	const auto count = static_cast<uint32_t>(2 * zones.size());
+	const auto [result, ticks] = queries.getResults<uint64_t>(
+		0,
+		count,
+		count * sizeof(uint64_t),
+		sizeof(uint64_t),
+		vk::QueryResultFlagBits::e64);
+	if (result != vk::Result::eSuccess) return;
+
+	// Ticks relative to the reference, the counter may have wrapped around its valid bits in between
+	uint64_t reference_ticks = 0;
+	trace::Time reference_time;
+	const auto offset = [&](const uint64_t tick) -> int64_t {
+		const uint64_t forward = (tick - reference_ticks) & mask;
+		if (forward <= mask >> 1) return static_cast<int64_t>(forward);
+		return -static_cast<int64_t>((reference_ticks - tick) & mask);
+	};
+
+	if (calibrated) {
+		reference_time = calibrate(reference_ticks);
+	} else {
+		reference_ticks = ticks[1];
+		for (uint32_t i = 3; i < count; i += 2) {
+			if (offset(ticks[i]) > 0) reference_ticks = ticks[i];
+		}
+		reference_time = fence_passed;
+	}
+
+	const auto time = [&](const uint64_t tick) {
+		return reference_time + static_cast<trace::Time>(std::llround(static_cast<double>(offset(tick)) * period));
+	};
+	for (uint32_t zone = 0; zone < zones.size(); zone++) {
+		track.record(zones[zone], time(ticks[2 * zone]), time(ticks[2 * zone + 1]));
+	}
+}
@@ -0,0 +1,60 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <vulkan/vulkan_raii.hpp>
+
+#include "DeviceCapabilities.h"
+#include "Trace.h"
+
+namespace raii = vk::raii;
+
+// GPU zones for the trace: timestamps around parts of a frame's command buffer, put on a track of their own once the
+// frame's fence has passed. With VK_EXT_calibrated_timestamps the device clock is mapped onto the CPU clock of the
+// trace, otherwise the end of the last zone is placed where the fence wait returned, which is a little too late.
+// Records nothing while tracing is off.
+class GpuTrace {
+public:
+	static constexpr uint32_t MAX_ZONES = 64; // Per frame, the rest are left out
+
+private:
+	const raii::Device &device;
+	raii::QueryPool queries{nullptr};
+	double period = 0.0; // Nanoseconds per tick
+	uint64_t mask = 0;
+	bool calibrated = false;
+	trace::Track &track;
+
+	bool recording = false;          // Tracing was on when the frame in flight began
+	std::vector<const char *> zones; // Names of the frame's zones, zone i has the timestamps 2i and 2i + 1
+	std::vector<uint32_t> open;      // Zones begun but not ended yet
+
+	[[nodiscard]] trace::Time calibrate(uint64_t &device_ticks) const;
+
+public:
+	// calibration_enabled: the device was created with VK_EXT_calibrated_timestamps
+	GpuTrace(
+		const raii::Device &_device,
+		const DeviceCapabilities &capabilities,
+		uint32_t queue_family,
+		bool calibration_enabled);
+	GpuTrace(const GpuTrace &) = delete;
+	GpuTrace &operator=(const GpuTrace &) = delete;
+
+	[[nodiscard]] bool supported() const { return static_cast<bool>(*queries); }
+	[[nodiscard]] bool timestamps_calibrated() const { return calibrated; }
+	// Whether this frame's zones are recorded, so callers can skip preparing them
+	[[nodiscard]] bool recording_frame() const { return recording; }
+
+	// At the start of the command buffer, outside of any render pass
+	void begin_frame(const raii::CommandBuffer &command_buffer);
+	// Zones nest, end() closes the last one begun
+	void begin(const raii::CommandBuffer &command_buffer, const std::string &name);
+	void end(const raii::CommandBuffer &command_buffer);
+	// After the frame's fence has passed, fence_passed being when the wait for it returned
+	void collect(trace::Time fence_passed);
+
+	// Whether the physical device can relate its timestamps to the trace clock
+	[[nodiscard]] static bool calibration_supported(const DeviceCapabilities &capabilities);
+};
@@ -0,0 +1,91 @@
+#include "InstanceBuffer.h"
+
+#include <optional>
+#include <stdexcept>
+#include <string>
+
+void InstanceBuffer::Batch::set(
+	const uint32_t i,
+	const glm::quat &rotation,
+	const glm::vec3 &position,
+	const float scale
+) const {
+	rotations[i] = {rotation.x, rotation.y, rotation.z, rotation.w};
+	positions[i] = {position, scale};
+}
+
+
+
+InstanceBuffer::InstanceBuffer(
+	const raii::Device &device,
+	const vk::PhysicalDeviceMemoryProperties &memory_properties,
+	const uint32_t frame_count,
+	const uint32_t _capacity
+):
+	capacity(_capacity)
+{
+	constexpr vk::MemoryPropertyFlags host_visible =
+		vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent;
+
+	const vk::BufferCreateInfo buffer_create_info = {
+		{},
+		static_cast<vk::DeviceSize>(capacity) * 2 * sizeof(glm::vec4),
+		vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eShaderDeviceAddress,
+		vk::SharingMode::eExclusive
+	};
+
+	for (uint32_t i = 0; i < frame_count; ++i) {
+		Frame &frame = frames.emplace_back();
+		frame.buffer = raii::Buffer{device, buffer_create_info};
+		const vk::MemoryRequirements requirements = frame.buffer.getMemoryRequirements();
+
+		// Prefer video memory the CPU can write to directly, fall back to plain host memory
+		std::optional<uint32_t> memory_type;
+		for (const bool local : {true, false}) {
+			const vk::MemoryPropertyFlags wanted = local ? host_visible | vk::MemoryPropertyFlagBits::eDeviceLocal : host_visible;
+			for (uint32_t type = 0; type < memory_properties.memoryTypeCount && !memory_type; ++type) {
+				if (!(requirements.memoryTypeBits & 1u << type)) continue;
+				if ((memory_properties.memoryTypes[type].propertyFlags & wanted) == wanted) memory_type = type;
+			}
+			if (memory_type) {
+				is_device_local = local;
+				break;
+			}
+		}
+		if (!memory_type) throw std::runtime_error("No host visible memory for the instance buffer");
+
+		const vk::MemoryAllocateFlagsInfo allocate_flags = {vk::MemoryAllocateFlagBits::eDeviceAddress};
+		frame.memory = raii::DeviceMemory{device, vk::MemoryAllocateInfo{requirements.size, *memory_type, &allocate_flags}};
+		frame.buffer.bindMemory(*frame.memory, 0);
+
+		frame.address = device.getBufferAddress(vk::BufferDeviceAddressInfo{*frame.buffer});
+		frame.mapped = static_cast<glm::vec4 *>(frame.memory.mapMemory(0, buffer_create_info.size));
+	}
+}
+
+void InstanceBuffer::begin_frame(const uint32_t frame) {
+	current = frame;
+	used = 0;
+}
+
+InstanceBuffer::Batch InstanceBuffer::allocate(const uint32_t count) {
+	if (count > capacity - used) {
+		throw std::runtime_error("Instance buffer full, " + std::to_string(capacity) + " instances per frame");
+	}
+
+	glm::vec4 *rotations = frames[current].mapped;
+	glm::vec4 *positions = rotations + capacity;
+	const Batch batch = {
+		used,
+		count,
+		{rotations + used, count},
+		{positions + used, count}
+	};
+	used += count;
+	return batch;
+}
+
+InstanceBuffer::Addresses InstanceBuffer::addresses() const {
+	const vk::DeviceAddress rotations = frames[current].address;
+	return {rotations, rotations + static_cast<vk::DeviceAddress>(capacity) * sizeof(glm::vec4)};
+}
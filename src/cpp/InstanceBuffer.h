@@ -0,0 +1,65 @@
+#pragma once
+#include <span>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <vulkan/vulkan_raii.hpp>
+
+namespace raii = vk::raii;
+
+// Per-instance transforms for instanced draws, written straight into persistently mapped memory.
+// Laid out as a structure of arrays: every rotation (unit quaternion, xyzw) and then every position (xyz, with a
+// uniform scale in w). Shaders index both arrays through their device addresses with the instance index.
+// There is one buffer per frame in flight, so a frame can be filled while the previous one is still drawn.
+class InstanceBuffer {
+public:
+	// A contiguous range of instances, drawn with one call using first as the first instance
+	struct Batch {
+		uint32_t first;
+		uint32_t count;
+		std::span<glm::vec4> rotations;
+		std::span<glm::vec4> positions;
+
+		void set(uint32_t i, const glm::quat &rotation, const glm::vec3 &position, float scale = 1.0f) const;
+	};
+
+	struct Addresses {
+		vk::DeviceAddress rotations;
+		vk::DeviceAddress positions;
+	};
+
+private:
+	struct Frame {
+		raii::DeviceMemory memory{nullptr};
+		raii::Buffer buffer{nullptr};
+		vk::DeviceAddress address = 0;
+		glm::vec4 *mapped = nullptr;
+	};
+
+	uint32_t capacity;
+	std::vector<Frame> frames;
+	uint32_t current = 0;
+	uint32_t used = 0;
+	bool is_device_local = false; // Mapped video memory, otherwise the GPU reads it over the bus
+
+public:
+	InstanceBuffer(
+		const raii::Device &device,
+		const vk::PhysicalDeviceMemoryProperties &memory_properties,
+		uint32_t frame_count,
+		uint32_t _capacity);
+
+	// Starts over in the frame's buffer, the GPU has to be done with what it held before. The memory is not
+	// cleared: allocating the same counts in the same order again hands back what was written last time, so
+	// only instances that changed need to be set.
+	void begin_frame(uint32_t frame);
+	// Throws if the frame's buffer is full
+	[[nodiscard]] Batch allocate(uint32_t count);
+
+	[[nodiscard]] Addresses addresses() const;
+	[[nodiscard]] uint32_t size() const { return used; }
+	[[nodiscard]] uint32_t max_instances() const { return capacity; }
+	[[nodiscard]] bool device_local() const { return is_device_local; }
+};
@@ -0,0 +1,79 @@
+#include "JobSystem.h"
+
+#include "Trace.h"
+
+JobSystem::JobSystem(const unsigned int thread_count) {
+	workers.reserve(thread_count);
+	for (unsigned int i = 0; i < thread_count; i++) {
+		workers.emplace_back([this, i](const std::stop_token &stop) {
+			trace::name_thread("Jobs " + std::to_string(i));
+			work(stop);
+		});
+	}
+}
+
+JobSystem::~JobSystem() {
+	for (auto &worker : workers) worker.request_stop();
+	batch_added.notify_all();
+	workers.clear();
+}
+
+void JobSystem::work(const std::stop_token &stop) {
+	while (true) {
+		std::shared_ptr<Batch> batch;
+		{
+			std::unique_lock lock{mutex};
+			if (!batch_added.wait(lock, stop, [this] { return !batches.empty(); })) return;
+			batch = batches.front();
+			// Every chunk is taken, the threads running them finish the batch
+			if (batch->next >= batch->chunks) {
+				batches.pop_front();
+				continue;
+			}
+		}
+		run(*batch);
+	}
+}
+
+void JobSystem::run(Batch &batch) {
+	size_t completed = 0;
+	for (size_t chunk; (chunk = batch.next.fetch_add(1)) < batch.chunks; completed++) {
+		const size_t begin = chunk * batch.grain;
+		TRACE_ZONE("parallel_for chunk");
+		try {
+			batch.function(begin, std::min(begin + batch.grain, batch.count));
+		} catch (...) {
+			std::lock_guard lock{mutex};
+			if (!batch.error) batch.error = std::current_exception();
+		}
+	}
+
+	if (completed && batch.done.fetch_add(completed) + completed == batch.chunks) {
+		{ std::lock_guard lock{mutex}; } // The caller is either waiting already or sees done before it waits
+		batch_finished.notify_all();
+	}
+}
+
+void JobSystem::parallel_for(const size_t count, size_t grain, const Range &function) {
+	if (count == 0) return;
+	grain = std::max<size_t>(grain, 1);
+	const size_t chunks = (count + grain - 1) / grain;
+	if (chunks == 1 || workers.empty()) {
+		function(0, count);
+		return;
+	}
+
+	const auto batch = std::make_shared<Batch>(function, count, grain, chunks);
+	{
+		std::lock_guard lock{mutex};
+		batches.push_back(batch);
+	}
+	batch_added.notify_all();
+
+	run(*batch);
+
+	std::unique_lock lock{mutex};
+	batch_finished.wait(lock, [&] { return batch->done == batch->chunks; });
+	std::erase(batches, batch);
+	if (batch->error) std::rethrow_exception(batch->error);
+}
@@ -0,0 +1,51 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Worker threads for data parallel loops. parallel_for() cuts a range into chunks which the workers and the calling
+// thread take in turns, and returns once all of them are done, rethrowing the first exception a chunk threw.
+class JobSystem {
+public:
+	using Range = std::function<void(size_t begin, size_t end)>;
+
+private:
+	struct Batch {
+		const Range &function;
+		size_t count;
+		size_t grain;
+		size_t chunks;
+		std::atomic<size_t> next = 0; // First chunk nobody took yet
+		std::atomic<size_t> done = 0;
+		std::exception_ptr error;     // Guarded by the mutex
+	};
+
+	std::mutex mutex;
+	std::condition_variable_any batch_added;
+	std::condition_variable batch_finished;
+	std::deque<std::shared_ptr<Batch>> batches;
+	std::vector<std::jthread> workers;
+
+	void work(const std::stop_token &stop);
+	void run(Batch &batch);
+
+public:
+	explicit JobSystem(unsigned int thread_count = std::max(2u, std::thread::hardware_concurrency()) - 1);
+	JobSystem(const JobSystem &) = delete;
+	JobSystem &operator=(const JobSystem &) = delete;
+	~JobSystem();
+
+	// Calls function on consecutive ranges of at most grain elements covering [0, count), possibly concurrently
+	void parallel_for(size_t count, size_t grain, const Range &function);
+
+	// Workers, the calling thread helps on top of these
+	[[nodiscard]] unsigned int thread_count() const { return static_cast<unsigned int>(workers.size()); }
+};
@@ -0,0 +1,307 @@
+#include "Log.h"
+
+#include <algorithm>
+#include <bit>
+#include <charconv>
+#include <cstdio>
+#include <iostream>
+#include <stdexcept>
+
+#include "Trace.h"
+#include "text_formatting.h"
+
+namespace {
+	// Appends the number as to_chars writes it, doubles with the 6 significant digits iostreams default to
+	template<typename T>
+	void append_number(std::string &out, const T value) {
+		char digits[32];
+		std::to_chars_result result;
+		if constexpr (std::is_floating_point_v<T>) {
+			result = std::to_chars(std::begin(digits), std::end(digits), value, std::chars_format::general, 6);
+		} else {
+			result = std::to_chars(std::begin(digits), std::end(digits), value);
+		}
+		out.append(digits, result.ptr);
+	}
+}
+
+const char *logging::name(const Level level) {
+	switch (level) {
+		case Level::Debug: return "DEBUG";
+		case Level::Info: return "INFO";
+		case Level::Warning: return "WARN";
+		case Level::Error: return "ERROR";
+	}
+	return "?";
+}
+
+void logging::append_line(std::string &out, const Entry &entry) {
+	char prefix[64];
+	const int length = std::snprintf(
+		prefix, sizeof(prefix), "[%10.3f] %-5s #%u ", entry.seconds, name(entry.level), entry.thread);
+	out.append(prefix, static_cast<size_t>(std::clamp(length, 0, static_cast<int>(sizeof(prefix) - 1))));
+	out += entry.message;
+	out += '\n';
+}
+
+
+
+logging::ConsoleSink::ConsoleSink(const Level _minimum) : minimum(_minimum) {}
+
+void logging::ConsoleSink::write(const Entry &entry) {
+	if (entry.level < minimum) return;
+	line.clear();
+	append_line(line, entry);
+	std::ostream &stream = entry.level == Level::Error ? std::cerr : std::cout;
+	stream.write(line.data(), static_cast<std::streamsize>(line.size()));
+}
+
+void logging::ConsoleSink::flush() {
+	std::cout.flush();
+}
+
+
+
+logging::FileSink::FileSink(const std::string &path) : file(path, std::ios::app) {
+	if (!file) throw std::runtime_error("Failed to open log file " + path);
+}
+
+void logging::FileSink::write(const Entry &entry) {
+	line.clear();
+	append_line(line, entry);
+	file.write(line.data(), static_cast<std::streamsize>(line.size()));
+}
+
+void logging::FileSink::flush() {
+	file.flush();
+}
+
+
+
+logging::WindowSink::WindowSink(std::string _title, const unsigned long _width)
+	: title(std::move(_title)), width(_width) {}
+
+// The wnd state is per thread, so the window lives entirely on the writer thread
+void logging::WindowSink::write(const Entry &entry) {
+	if (!open) {
+		wnd::begin(title, wnd::none, width);
+		open = true;
+	}
+	line.clear();
+	append_line(line, entry);
+	line.pop_back();
+	wnd::print(line);
+}
+
+void logging::WindowSink::flush() {
+	wnd::flush();
+}
+
+void logging::WindowSink::close() {
+	if (!open) return;
+	wnd::end();
+	open = false;
+}
+
+
+
+logging::Logger::Logger() : cells(new Cell[CAPACITY]), start(std::chrono::steady_clock::now()) {
+	static_assert(std::has_single_bit(CAPACITY));
+	static_assert(PAYLOAD < 256, "Record::size is a byte");
+	for (size_t i = 0; i < CAPACITY; i++) cells[i].sequence.store(i, std::memory_order_relaxed);
+
+	writer = std::jthread([this](const std::stop_token &stop) {
+		trace::name_thread("Log");
+		write(stop);
+	});
+}
+
+logging::Logger::~Logger() {
+	writer.request_stop();
+	wake.fetch_add(1, std::memory_order_release);
+	wake.notify_one();
+	writer.join();
+}
+
+void logging::Logger::add_sink(std::unique_ptr<Sink> sink) {
+	const std::lock_guard lock(sinks_mutex);
+	sinks.push_back(std::move(sink));
+}
+
+uint32_t logging::Logger::thread_number() {
+	static std::atomic<uint32_t> next = 0;
+	thread_local const uint32_t number = next.fetch_add(1, std::memory_order_relaxed);
+	return number;
+}
+
+// Arguments that do not fit are left out, strings are cut to the space left
+void logging::Logger::put(Record &record, const Tag tag, const void *data, size_t size) {
+	const bool string = tag == Tag::String;
+	const size_t header = 1 + string; // Tag and for strings a length byte
+	if (record.size + header > PAYLOAD) return;
+	const size_t space = PAYLOAD - record.size - header;
+	if (string) {
+		size = std::min({size, space, size_t{UINT8_MAX}});
+	} else if (size > space) {
+		return;
+	}
+
+	std::byte *out = record.payload + record.size;
+	*out++ = static_cast<std::byte>(tag);
+	if (string) *out++ = static_cast<std::byte>(size);
+	std::memcpy(out, data, size);
+	record.size = static_cast<uint8_t>(record.size + header + size);
+}
+
+logging::Logger::Cell *logging::Logger::claim() {
+	uint64_t position = enqueue_position.load(std::memory_order_relaxed);
+	while (true) {
+		Cell &cell = cells[position & (CAPACITY - 1)];
+		const uint64_t sequence = cell.sequence.load(std::memory_order_acquire);
+		if (sequence == position) {
+			if (enqueue_position.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) return &cell;
+		} else if (sequence < position) {
+			// The writer has not taken the record from a lap ago yet
+			dropped.fetch_add(1, std::memory_order_relaxed);
+			return nullptr;
+		} else {
+			position = enqueue_position.load(std::memory_order_relaxed);
+		}
+	}
+}
+
+void logging::Logger::publish(Cell &cell) {
+	cell.sequence.store(cell.sequence.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+	accepted.fetch_add(1, std::memory_order_relaxed);
+	wake.fetch_add(1, std::memory_order_release);
+	wake.notify_one();
+}
+
+void logging::Logger::flush() {
+	const uint64_t target = accepted.load(std::memory_order_relaxed);
+	for (uint64_t done; (done = written.load(std::memory_order_acquire)) < target;) written.wait(done);
+}
+
+void logging::Logger::format(const Record &record, std::string &out) const {
+	const std::byte *argument = record.payload;
+	const std::byte *end = record.payload + record.size;
+
+	const auto read = [&]<typename T>(T &value) {
+		std::memcpy(&value, argument, sizeof(T));
+		argument += sizeof(T);
+	};
+
+	for (const char *c = record.format; *c; c++) {
+		if (c[0] != '{' || c[1] != '}' || argument == end) {
+			out += *c;
+			continue;
+		}
+		c++;
+
+		const auto tag = static_cast<Tag>(*argument++);
+		switch (tag) {
+			case Tag::Signed: {
+				int64_t value;
+				read(value);
+				append_number(out, value);
+				break;
+			}
+			case Tag::Unsigned: {
+				uint64_t value;
+				read(value);
+				append_number(out, value);
+				break;
+			}
+			case Tag::Double: {
+				double value;
+				read(value);
+				append_number(out, value);
+				break;
+			}
+			case Tag::Bool: {
+				bool value;
+				read(value);
+				out += value ? "true" : "false";
+				break;
+			}
+			case Tag::String: {
+				const auto length = static_cast<size_t>(*argument++);
+				out.append(reinterpret_cast<const char *>(argument), length);
+				argument += length;
+				break;
+			}
+		}
+	}
+}
+
+// Drains the ring in batches, flushing the sinks after each, and sleeps on wake while it is empty
+void logging::Logger::write(const std::stop_token &stop) {
+	std::string message;
+	uint64_t reported_drops = 0;
+
+	while (true) {
+		const uint32_t seen = wake.load(std::memory_order_acquire);
+		uint64_t count = 0;
+		{
+			const std::lock_guard lock(sinks_mutex);
+			while (true) {
+				Cell &cell = cells[dequeue_position & (CAPACITY - 1)];
+				if (cell.sequence.load(std::memory_order_acquire) != dequeue_position + 1) break;
+
+				const Record &record = cell.record;
+				message.clear();
+				format(record, message);
+				const Entry entry{
+					record.level,
+					std::chrono::duration<double>(record.time - start).count(),
+					record.thread,
+					message,
+				};
+				cell.sequence.store(dequeue_position + CAPACITY, std::memory_order_release);
+				dequeue_position++;
+
+				for (const std::unique_ptr<Sink> &sink : sinks) sink->write(entry);
+				count++;
+			}
+
+			if (const uint64_t drops = dropped.load(std::memory_order_relaxed); drops != reported_drops) {
+				message = "Dropped " + std::to_string(drops - reported_drops) + " records, the log queue was full";
+				const Entry entry{
+					Level::Warning,
+					std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count(),
+					thread_number(),
+					message,
+				};
+				for (const std::unique_ptr<Sink> &sink : sinks) sink->write(entry);
+				reported_drops = drops;
+				if (!count) {
+					for (const std::unique_ptr<Sink> &sink : sinks) sink->flush();
+				}
+			}
+
+			if (count) {
+				for (const std::unique_ptr<Sink> &sink : sinks) sink->flush();
+			} else if (stop.stop_requested()) {
+				for (const std::unique_ptr<Sink> &sink : sinks) {
+					sink->close();
+					sink->flush();
+				}
+				return;
+			}
+		}
+
+		if (count) {
+			written.fetch_add(count, std::memory_order_release);
+			written.notify_all();
+			continue;
+		}
+		wake.wait(seen, std::memory_order_acquire);
+	}
+}
+
+
+
+logging::Logger &logging::logger() {
+	static Logger instance;
+	return instance;
+}
@@ -0,0 +1,213 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// Asynchronous log. A thread logging a record only claims a slot of a lock-free ring buffer and copies the
+// arguments in binary into it. A writer thread formats the records and hands the text to the sinks, so nothing on
+// the logging thread waits for a terminal or a file. A full ring drops the record and counts it instead of waiting.
+//
+// Format strings are literals with {} for each argument in order. Arguments may be integers, floating point
+// numbers, bools, enums and strings; strings are cut to what fits into the record.
+namespace logging {
+	enum class Level : uint8_t {
+		Debug,
+		Info,
+		Warning,
+		Error,
+	};
+
+	[[nodiscard]] const char *name(Level level);
+
+	// A formatted record as the sinks get it
+	struct Entry {
+		Level level;
+		double seconds;  // Since the logger was created
+		uint32_t thread; // Numbered in the order threads logged their first record
+		std::string_view message;
+	};
+
+	// "[   12.345] INFO  #1 message"
+	void append_line(std::string &out, const Entry &entry);
+
+	// Only ever called from the writer thread
+	class Sink {
+	public:
+		virtual ~Sink() = default;
+		virtual void write(const Entry &entry) = 0;
+		// After every batch of records
+		virtual void flush() {}
+		// Before the writer thread exits
+		virtual void close() {}
+	};
+
+	// Standard output, errors to standard error
+	class ConsoleSink final : public Sink {
+		Level minimum;
+		std::string line;
+
+	public:
+		explicit ConsoleSink(Level _minimum = Level::Debug);
+		void write(const Entry &entry) override;
+		void flush() override;
+	};
+
+	// Appends to a file, throws if it cannot be opened
+	class FileSink final : public Sink {
+		std::ofstream file;
+		std::string line;
+
+	public:
+		explicit FileSink(const std::string &path);
+		void write(const Entry &entry) override;
+		void flush() override;
+	};
+
+	// Lines of a wnd window, opened with the first record and closed with the logger
+	class WindowSink final : public Sink {
+		std::string title;
+		unsigned long width;
+		bool open = false;
+		std::string line;
+
+	public:
+		explicit WindowSink(std::string _title, unsigned long _width = 64);
+		void write(const Entry &entry) override;
+		void flush() override;
+		void close() override;
+	};
+
+	class Logger {
+	public:
+		static constexpr size_t CAPACITY = 4096; // Records, a power of two
+		static constexpr size_t PAYLOAD = 232;   // Bytes of encoded arguments per record
+
+	private:
+		enum class Tag : uint8_t {
+			Signed,
+			Unsigned,
+			Double,
+			Bool,
+			String,
+		};
+
+		struct Record {
+			const char *format;
+			std::chrono::steady_clock::time_point time;
+			uint32_t thread;
+			Level level;
+			uint8_t size; // Used bytes of the payload
+			std::byte payload[PAYLOAD];
+		};
+
+		// Vyukov's bounded queue: a cell is free for the producer at position p when its sequence is p, and holds
+		// the record for the consumer when it is p + 1
+		struct alignas(64) Cell {
+			std::atomic<uint64_t> sequence;
+			Record record;
+		};
+
+		std::unique_ptr<Cell[]> cells;
+		alignas(64) std::atomic<uint64_t> enqueue_position = 0;
+		alignas(64) uint64_t dequeue_position = 0; // Writer thread only
+		std::atomic<uint32_t> wake = 0;            // Bumped after every record, the writer waits on it
+		std::atomic<uint64_t> accepted = 0;
+		std::atomic<uint64_t> written = 0;
+		std::atomic<uint64_t> dropped = 0;
+		std::atomic<Level> minimum = Level::Info;
+		std::chrono::steady_clock::time_point start;
+
+		std::mutex sinks_mutex;
+		std::vector<std::unique_ptr<Sink>> sinks;
+
+		std::jthread writer; // Last, so it is gone before anything it uses
+
+		static uint32_t thread_number();
+
+		static void put(Record &record, Tag tag, const void *data, size_t size);
+
+		template<typename T>
+		static void encode(Record &record, const T &value) {
+			if constexpr (std::is_same_v<T, bool>) {
+				put(record, Tag::Bool, &value, sizeof(bool));
+			} else if constexpr (std::is_enum_v<T>) {
+				encode(record, static_cast<std::underlying_type_t<T>>(value));
+			} else if constexpr (std::is_integral_v<T> && std::is_signed_v<T>) {
+				const int64_t number = value;
+				put(record, Tag::Signed, &number, sizeof(number));
+			} else if constexpr (std::is_integral_v<T>) {
+				const uint64_t number = value;
+				put(record, Tag::Unsigned, &number, sizeof(number));
+			} else if constexpr (std::is_floating_point_v<T>) {
+				const double number = value;
+				put(record, Tag::Double, &number, sizeof(number));
+			} else {
+				const std::string_view text = value;
+				put(record, Tag::String, text.data(), text.size());
+			}
+		}
+
+		// Null if the ring is full
+		Cell *claim();
+		void publish(Cell &cell);
+
+		void write(const std::stop_token &stop);
+		void format(const Record &record, std::string &out) const;
+
+	public:
+		Logger();
+		Logger(const Logger &) = delete;
+		Logger &operator=(const Logger &) = delete;
+		// Writes out everything logged before
+		~Logger();
+
+		void add_sink(std::unique_ptr<Sink> sink);
+		void set_level(Level level) { minimum.store(level, std::memory_order_relaxed); }
+		[[nodiscard]] bool enabled(const Level level) const { return level >= minimum.load(std::memory_order_relaxed); }
+
+		template<typename... Args>
+		void log(const Level level, const char *format, const Args &... args) {
+			if (!enabled(level)) return;
+			Cell *cell = claim();
+			if (!cell) return;
+
+			Record &record = cell->record;
+			record.format = format;
+			record.time = std::chrono::steady_clock::now();
+			record.thread = thread_number();
+			record.level = level;
+			record.size = 0;
+			(encode(record, args), ...);
+			publish(*cell);
+		}
+
+		// Returns once everything logged so far went through the sinks
+		void flush();
+		[[nodiscard]] uint64_t dropped_count() const { return dropped.load(std::memory_order_relaxed); }
+	};
+
+	// The process wide logger, without sinks until some are added
+	Logger &logger();
+
+	template<size_t N, typename... Args>
+	void debug(const char (&format)[N], const Args &... args) { logger().log(Level::Debug, format, args...); }
+
+	template<size_t N, typename... Args>
+	void info(const char (&format)[N], const Args &... args) { logger().log(Level::Info, format, args...); }
+
+	template<size_t N, typename... Args>
+	void warning(const char (&format)[N], const Args &... args) { logger().log(Level::Warning, format, args...); }
+
+	template<size_t N, typename... Args>
+	void error(const char (&format)[N], const Args &... args) { logger().log(Level::Error, format, args...); }
+}
@@ -0,0 +1,519 @@
+#include "PipelineFactory.h"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <optional>
+
+namespace {
+	// Fixed-function state of every pipeline. Points into itself, so it has to stay where it was built.
+	struct FixedState {
+		// Extended dynamic state 1 and 2 are core in Vulkan 1.3, so none of this multiplies pipelines
+		std::vector<vk::DynamicState> dynamic_states = {
+			vk::DynamicState::eViewport,
+			vk::DynamicState::eScissor,
+			vk::DynamicState::eCullMode,
+			vk::DynamicState::eFrontFace,
+			vk::DynamicState::ePrimitiveTopology,
+			vk::DynamicState::eDepthTestEnable,
+			vk::DynamicState::eDepthWriteEnable,
+			vk::DynamicState::eDepthCompareOp,
+			vk::DynamicState::eDepthBiasEnable,
+			vk::DynamicState::ePrimitiveRestartEnable,
+			vk::DynamicState::eRasterizerDiscardEnable
+		};
+		vk::PipelineDynamicStateCreateInfo dynamic;
+
+		std::vector<vk::VertexInputAttributeDescription> vertex_attributes;
+		vk::VertexInputBindingDescription vertex_binding;
+		vk::PipelineVertexInputStateCreateInfo vertex_input;
+
+		vk::PipelineInputAssemblyStateCreateInfo input_assembly = {
+			{},
+			vk::PrimitiveTopology::eTriangleList,
+			false,
+		};
+
+		vk::PipelineViewportStateCreateInfo viewport = {
+			{},
+			1,
+			nullptr,
+			1,
+			nullptr,
+		};
+
+		vk::PipelineRasterizationStateCreateInfo rasterization = {
+			{},
+			false,
+			false,
+			vk::PolygonMode::eFill,
+			vk::CullModeFlagBits::eBack,
+			vk::FrontFace::eClockwise,
+			false,
+			0.0f,
+			0.0f,
+			1.0f,
+			1.0f,
+		};
+
+		vk::PipelineMultisampleStateCreateInfo multisample = {
+			{},
+			vk::SampleCountFlagBits::e1,
+			false,
+			0.0f,
+			nullptr,
+			false,
+			false
+		};
+
+		vk::PipelineColorBlendAttachmentState blend_attachment = {
+			false,
+			vk::BlendFactor::eSrcAlpha,
+			vk::BlendFactor::eOneMinusSrcAlpha,
+			vk::BlendOp::eAdd,
+			vk::BlendFactor::eOne,
+			vk::BlendFactor::eZero,
+			vk::BlendOp::eAdd,
+			vk::ColorComponentFlagBits::eR |
+			vk::ColorComponentFlagBits::eG |
+			vk::ColorComponentFlagBits::eB |
+			vk::ColorComponentFlagBits::eA,
+		};
+		vk::PipelineColorBlendStateCreateInfo blend;
+
+		// Test, write and compare op are dynamic
+		vk::PipelineDepthStencilStateCreateInfo depth_stencil = {
+			{},
+			false,
+			false,
+			vk::CompareOp::eGreaterOrEqual,
+			false,
+			false,
+			{},
+			{},
+			0.0f,
+			1.0f
+		};
+
+		vk::Format color_format;
+		vk::Format depth_format;
+		vk::PipelineRenderingCreateInfo rendering;
+
+		FixedState(
+			const spirv::PipelineInterface &interface,
+			const vk::Format _color_format,
+			const vk::Format _depth_format,
+			const vk::SampleCountFlagBits samples,
+			const bool dynamic_blend,
+			const bool blend_enable
+		):
+			color_format(_color_format),
+			depth_format(_depth_format)
+		{
+			multisample.rasterizationSamples = samples;
+
+			if (dynamic_blend) {
+				dynamic_states.push_back(vk::DynamicState::eColorBlendEnableEXT);
+			} else {
+				blend_attachment.blendEnable = blend_enable;
+			}
+
+			dynamic = {
+				{},
+				static_cast<uint32_t>(dynamic_states.size()),
+				dynamic_states.data()
+			};
+
+			// Reflected inputs are read from a single interleaved vertex buffer, packed in location order
+			uint32_t vertex_stride = 0;
+			for (const spirv::VertexInput &input : interface.vertex_inputs) {
+				vertex_attributes.emplace_back(input.location, 0, input.format, vertex_stride);
+				vertex_stride += input.size;
+			}
+
+			vertex_binding = {
+				0,
+				vertex_stride,
+				vk::VertexInputRate::eVertex
+			};
+
+			vertex_input = {
+				{},
+				vertex_attributes.empty() ? 0u : 1u,
+				&vertex_binding,
+				static_cast<uint32_t>(vertex_attributes.size()),
+				vertex_attributes.data()
+			};
+
+			blend = {
+				{},
+				false,
+				vk::LogicOp::eCopy,
+				1,
+				&blend_attachment,
+				{0.0, 0.0, 0.0, 0.0}
+			};
+
+			rendering = {
+				{},
+				1,
+				&color_format,
+				depth_format,
+				vk::Format::eUndefined,
+			};
+		}
+
+		FixedState(const FixedState &) = delete;
+		FixedState &operator=(const FixedState &) = delete;
+
+		[[nodiscard]] std::vector<uint32_t> vertex_input_key() const {
+			std::vector<uint32_t> key = {
+				static_cast<uint32_t>(input_assembly.topology),
+				vertex_binding.stride
+			};
+			for (const auto &attribute : vertex_attributes) {
+				key.push_back(attribute.location);
+				key.push_back(static_cast<uint32_t>(attribute.format));
+				key.push_back(attribute.offset);
+			}
+			return key;
+		}
+
+		[[nodiscard]] std::vector<uint32_t> output_key() const {
+			return {
+				static_cast<uint32_t>(color_format),
+				static_cast<uint32_t>(depth_format),
+				static_cast<uint32_t>(multisample.rasterizationSamples),
+				blend_attachment.blendEnable,
+				static_cast<uint32_t>(dynamic_states.size())
+			};
+		}
+	};
+
+	// Vertex and fragment stage of one shader permutation. Points into itself as well.
+	struct ShaderStages {
+		ShaderPermutation::Specialization specialization;
+		vk::SpecializationInfo specialization_info;
+		raii::ShaderModule module;
+		std::array<vk::PipelineShaderStageCreateInfo, 2> stages;
+
+		ShaderStages(const raii::Device &device, const ShaderSource &source, const ShaderPermutation &permutation):
+			specialization(permutation.specialize(source.reflected)),
+			specialization_info(specialization.info()),
+			module(device, vk::ShaderModuleCreateInfo{
+				{},
+				source.code.size(),
+				reinterpret_cast<const uint32_t *>(source.code.data())
+			})
+		{
+			// Both stages share one map, entries for constants a stage does not declare are ignored
+			stages = {
+				vk::PipelineShaderStageCreateInfo{
+					{},
+					vk::ShaderStageFlagBits::eVertex,
+					module,
+					source.reflected.entry_point(vk::ShaderStageFlagBits::eVertex).name.c_str(),
+					&specialization_info
+				},
+				vk::PipelineShaderStageCreateInfo{
+					{},
+					vk::ShaderStageFlagBits::eFragment,
+					module,
+					source.reflected.entry_point(vk::ShaderStageFlagBits::eFragment).name.c_str(),
+					&specialization_info
+				}
+			};
+		}
+
+		ShaderStages(const ShaderStages &) = delete;
+		ShaderStages &operator=(const ShaderStages &) = delete;
+	};
+
+	spirv::PipelineInterface interface_of(const ShaderSource &source) {
+		const std::array entry_points = {
+			&source.reflected.entry_point(vk::ShaderStageFlagBits::eVertex),
+			&source.reflected.entry_point(vk::ShaderStageFlagBits::eFragment)
+		};
+		return spirv::merge(entry_points);
+	}
+
+	vk::PushConstantRange push_constant_range(const spirv::PipelineInterface &interface) {
+		return interface.push_constants.empty() ? vk::PushConstantRange{} : interface.push_constants.front();
+	}
+}
+
+
+
+PipelineFactory::PipelineFactory(const raii::Device &_device, PipelineLayoutCache &_layout_cache):
+	device(_device),
+	layout_cache(_layout_cache)
+{
+
+}
+
+
+
+template<typename Map, typename Create>
+PipelineFactory::Library PipelineFactory::cached(Map &map, const typename Map::key_type &key, const Create &create) {
+	{
+		std::lock_guard lock{mutex};
+		if (const auto it = map.find(key); it != map.end()) return it->second;
+	}
+
+	// Compiled outside the lock; if two threads race for the same part the first one stored is kept
+	Library library = std::make_shared<const raii::Pipeline>(create());
+
+	std::lock_guard lock{mutex};
+	// A build that was still running when its shader was evicted links the library but does not keep it
+	if (evicted(key)) return library;
+	return map.try_emplace(key, std::move(library)).first->second;
+}
+
+
+
+void PipelineFactory::configure(
+	const vk::Format _color_format,
+	const vk::Format _depth_format,
+	const bool _use_libraries,
+	const bool _dynamic_blend
+) {
+	std::lock_guard lock{mutex};
+	color_format = _color_format;
+	depth_format = _depth_format;
+	use_libraries = _use_libraries;
+	dynamic_blend = _dynamic_blend;
+	vertex_input_libraries.clear();
+	output_libraries.clear();
+	pre_rasterization_libraries.clear();
+	fragment_libraries.clear();
+}
+
+
+
+bool PipelineFactory::create_cache(const std::vector<char> &data, const vk::PhysicalDeviceProperties &properties) {
+	// Drivers have to reject foreign data themselves, checking the header first keeps a broken one from trying
+	vk::PipelineCacheHeaderVersionOne header{};
+	bool compatible = data.size() >= sizeof(header);
+	if (compatible) {
+		std::memcpy(&header, data.data(), sizeof(header));
+		compatible =
+			header.headerSize >= sizeof(header) &&
+			header.headerVersion == vk::PipelineCacheHeaderVersion::eOne &&
+			header.vendorID == properties.vendorID &&
+			header.deviceID == properties.deviceID &&
+			header.pipelineCacheUUID == properties.pipelineCacheUUID;
+	}
+
+	cache = raii::PipelineCache{
+		device,
+		vk::PipelineCacheCreateInfo{
+			{},
+			compatible ? data.size() : 0,
+			compatible ? data.data() : nullptr
+		}
+	};
+	return compatible;
+}
+
+
+
+std::vector<uint8_t> PipelineFactory::cache_data() const {
+	if (!*cache) return {};
+	return cache.getData();
+}
+
+
+
+GraphicsPipeline PipelineFactory::build(
+	const ShaderSource &source,
+	const ShaderPermutation &permutation,
+	const bool blend,
+	const vk::SampleCountFlagBits samples
+) {
+	return use_libraries
+		? build_linked(source, permutation, blend, samples)
+		: build_monolithic(source, permutation, blend, samples);
+}
+
+
+
+void PipelineFactory::set_draw_state(const raii::CommandBuffer &command_buffer, const DrawState &state) const {
+	command_buffer.setCullMode(state.cull_mode);
+	command_buffer.setFrontFace(state.front_face);
+	command_buffer.setPrimitiveTopology(state.topology);
+	command_buffer.setDepthTestEnable(state.depth_test);
+	command_buffer.setDepthWriteEnable(state.depth_write);
+	command_buffer.setDepthCompareOp(state.depth_compare);
+	command_buffer.setDepthBiasEnable(state.depth_bias);
+	command_buffer.setPrimitiveRestartEnable(false);
+	command_buffer.setRasterizerDiscardEnable(false);
+
+	if (dynamic_blend) {
+		const vk::Bool32 blend = state.blend;
+		command_buffer.setColorBlendEnableEXT(0, blend);
+	}
+}
+
+
+
+GraphicsPipeline PipelineFactory::build_monolithic(
+	const ShaderSource &source,
+	const ShaderPermutation &permutation,
+	const bool blend,
+	const vk::SampleCountFlagBits samples
+) {
+	const spirv::PipelineInterface interface = interface_of(source);
+	const vk::PipelineLayout layout = layout_cache.get(interface);
+	const FixedState state{interface, color_format, depth_format, samples, dynamic_blend, blend};
+	const ShaderStages shaders{device, source, permutation};
+
+	const vk::GraphicsPipelineCreateInfo pipeline_create_info = {
+		{},
+		static_cast<uint32_t>(shaders.stages.size()),
+		shaders.stages.data(),
+		&state.vertex_input,
+		&state.input_assembly,
+		nullptr,
+		&state.viewport,
+		&state.rasterization,
+		&state.multisample,
+		&state.depth_stencil,
+		&state.blend,
+		&state.dynamic,
+		layout,
+		nullptr,
+		0,
+		nullptr,
+		-1,
+		&state.rendering
+	};
+
+	return {
+		raii::Pipeline{
+			device,
+			cache,
+			pipeline_create_info
+		},
+		layout,
+		push_constant_range(interface),
+		samples
+	};
+}
+
+
+
+GraphicsPipeline PipelineFactory::build_linked(
+	const ShaderSource &source,
+	const ShaderPermutation &permutation,
+	const bool blend,
+	const vk::SampleCountFlagBits samples
+) {
+	const spirv::PipelineInterface interface = interface_of(source);
+	const vk::PipelineLayout layout = layout_cache.get(interface);
+	const FixedState state{interface, color_format, depth_format, samples, dynamic_blend, blend};
+
+	// Both shader parts come from the same module, so it is only compiled if one of them is missing
+	std::optional<ShaderStages> shaders;
+	const auto stages = [&]() -> const ShaderStages & {
+		if (!shaders) shaders.emplace(device, source, permutation);
+		return *shaders;
+	};
+
+	// The fragment shader part includes the multisample state, the pre-rasterization part does not
+	const ShaderKey shader_key{source.id, permutation, vk::SampleCountFlagBits::e1};
+	const ShaderKey fragment_key{source.id, permutation, samples};
+
+	const Library vertex_input = cached(vertex_input_libraries, state.vertex_input_key(), [&] {
+		vk::GraphicsPipelineCreateInfo create_info{};
+		create_info.pVertexInputState = &state.vertex_input;
+		create_info.pInputAssemblyState = &state.input_assembly;
+		create_info.pDynamicState = &state.dynamic;
+		return create_library(vk::GraphicsPipelineLibraryFlagBitsEXT::eVertexInputInterface, create_info);
+	});
+
+	const Library pre_rasterization = cached(pre_rasterization_libraries, shader_key, [&] {
+		vk::GraphicsPipelineCreateInfo create_info{};
+		create_info.pNext = &state.rendering;
+		create_info.stageCount = 1;
+		create_info.pStages = &stages().stages[0];
+		create_info.pViewportState = &state.viewport;
+		create_info.pRasterizationState = &state.rasterization;
+		create_info.pDynamicState = &state.dynamic;
+		create_info.layout = layout;
+		return create_library(vk::GraphicsPipelineLibraryFlagBitsEXT::ePreRasterizationShaders, create_info);
+	});
+
+	const Library fragment = cached(fragment_libraries, fragment_key, [&] {
+		vk::GraphicsPipelineCreateInfo create_info{};
+		create_info.pNext = &state.rendering;
+		create_info.stageCount = 1;
+		create_info.pStages = &stages().stages[1];
+		create_info.pMultisampleState = &state.multisample;
+		create_info.pDepthStencilState = &state.depth_stencil;
+		create_info.pDynamicState = &state.dynamic;
+		create_info.layout = layout;
+		return create_library(vk::GraphicsPipelineLibraryFlagBitsEXT::eFragmentShader, create_info);
+	});
+
+	const Library output = cached(output_libraries, state.output_key(), [&] {
+		vk::GraphicsPipelineCreateInfo create_info{};
+		create_info.pNext = &state.rendering;
+		create_info.pMultisampleState = &state.multisample;
+		create_info.pColorBlendState = &state.blend;
+		create_info.pDynamicState = &state.dynamic;
+		return create_library(vk::GraphicsPipelineLibraryFlagBitsEXT::eFragmentOutputInterface, create_info);
+	});
+
+	// Linking without link time optimisation is the cheap part the libraries exist for
+	const std::array<vk::Pipeline, 4> libraries = {**vertex_input, **pre_rasterization, **fragment, **output};
+	const vk::PipelineLibraryCreateInfoKHR link_info = {
+		static_cast<uint32_t>(libraries.size()),
+		libraries.data()
+	};
+
+	vk::GraphicsPipelineCreateInfo create_info{};
+	create_info.pNext = &link_info;
+	create_info.layout = layout;
+
+	return {
+		raii::Pipeline{
+			device,
+			cache,
+			create_info
+		},
+		layout,
+		push_constant_range(interface),
+		samples
+	};
+}
+
+
+
+raii::Pipeline PipelineFactory::create_library(
+	const vk::GraphicsPipelineLibraryFlagsEXT part,
+	vk::GraphicsPipelineCreateInfo create_info
+) const {
+	const vk::GraphicsPipelineLibraryCreateInfoEXT library_info = {part, create_info.pNext};
+	create_info.pNext = &library_info;
+	create_info.flags |= vk::PipelineCreateFlagBits::eLibraryKHR;
+
+	return raii::Pipeline{device, cache, create_info};
+}
+
+
+
+void PipelineFactory::evict_shader_libraries(const uint64_t keep_shader_id) {
+	std::lock_guard lock{mutex};
+	first_kept_shader_id = std::max(first_kept_shader_id, keep_shader_id);
+	const auto stale = [keep_shader_id](const auto &library) { return library.first.shader_id != keep_shader_id; };
+	std::erase_if(pre_rasterization_libraries, stale);
+	std::erase_if(fragment_libraries, stale);
+}
+
+
+
+size_t PipelineFactory::library_count() {
+	std::lock_guard lock{mutex};
+	return vertex_input_libraries.size() + output_libraries.size()
+		+ pre_rasterization_libraries.size() + fragment_libraries.size();
+}
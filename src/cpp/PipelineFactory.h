@@ -0,0 +1,122 @@
+#pragma once
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <map>
+#include <vector>
+
+#include <vulkan/vulkan_raii.hpp>
+
+#include "PipelineLayoutCache.h"
+#include "PipelineManager.h"
+#include "ShaderPermutation.h"
+#include "SpirvReflection.h"
+
+namespace raii = vk::raii;
+
+struct ShaderSource {
+	std::vector<char> code;
+	spirv::Module reflected;
+	uint64_t id; // Increases with every load, tells reloaded versions of a file apart
+};
+
+// Per-draw state set through extended dynamic state instead of being compiled into pipelines
+struct DrawState {
+	vk::CullModeFlags cull_mode = vk::CullModeFlagBits::eBack;
+	vk::FrontFace front_face = vk::FrontFace::eClockwise;
+	vk::PrimitiveTopology topology = vk::PrimitiveTopology::eTriangleList; // Has to stay a triangle topology
+	bool depth_test = false;
+	bool depth_write = false;
+	vk::CompareOp depth_compare = vk::CompareOp::eLess;
+	bool depth_bias = false;
+	bool blend = false; // Dynamic only with VK_EXT_extended_dynamic_state3, otherwise part of the pipeline
+};
+
+// Builds the graphics pipelines of the renderer. With VK_EXT_graphics_pipeline_library the four pipeline parts
+// are compiled once per distinct state and only linked per pipeline, otherwise every pipeline is created whole.
+// Safe to call build() from several threads at once.
+class PipelineFactory {
+	using Library = std::shared_ptr<const raii::Pipeline>; // Shared so eviction never pulls one out of a link
+
+	struct ShaderKey {
+		uint64_t shader_id;
+		ShaderPermutation permutation;
+		vk::SampleCountFlagBits samples;
+
+		bool operator==(const ShaderKey &) const = default;
+	};
+
+	struct ShaderKeyHash {
+		size_t operator()(const ShaderKey &key) const {
+			return key.permutation.hash() ^ key.shader_id * 0x9E3779B97F4A7C15ull ^ static_cast<size_t>(key.samples) << 56;
+		}
+	};
+
+	const raii::Device &device;
+	PipelineLayoutCache &layout_cache;
+	vk::Format color_format = vk::Format::eUndefined;
+	vk::Format depth_format = vk::Format::eUndefined;
+	bool use_libraries = false;
+	bool dynamic_blend = false;
+
+	raii::PipelineCache cache{nullptr}; // Used by every pipeline and library, synchronised by the driver
+
+	std::mutex mutex;
+	std::map<std::vector<uint32_t>, Library> vertex_input_libraries;
+	std::map<std::vector<uint32_t>, Library> output_libraries;
+	std::unordered_map<ShaderKey, Library, ShaderKeyHash> pre_rasterization_libraries;
+	std::unordered_map<ShaderKey, Library, ShaderKeyHash> fragment_libraries;
+	uint64_t first_kept_shader_id = 0; // Shader libraries of older shaders are evicted and not cached again
+
+	[[nodiscard]] bool evicted(const ShaderKey &key) const { return key.shader_id < first_kept_shader_id; }
+	template<typename Key>
+	[[nodiscard]] bool evicted(const Key &) const { return false; }
+
+	template<typename Map, typename Create>
+	Library cached(Map &map, const typename Map::key_type &key, const Create &create);
+
+	[[nodiscard]] GraphicsPipeline build_monolithic(
+		const ShaderSource &source,
+		const ShaderPermutation &permutation,
+		bool blend,
+		vk::SampleCountFlagBits samples);
+	[[nodiscard]] GraphicsPipeline build_linked(
+		const ShaderSource &source,
+		const ShaderPermutation &permutation,
+		bool blend,
+		vk::SampleCountFlagBits samples);
+	[[nodiscard]] raii::Pipeline create_library(
+		vk::GraphicsPipelineLibraryFlagsEXT part,
+		vk::GraphicsPipelineCreateInfo create_info) const;
+
+public:
+	PipelineFactory(const raii::Device &_device, PipelineLayoutCache &_layout_cache);
+
+	// Has to be called before the first build(), once the device and swapchain exist
+	void configure(vk::Format _color_format, vk::Format _depth_format, bool _use_libraries, bool _dynamic_blend);
+	// Creates the pipeline cache, seeded with cache_data() of an earlier run unless that came from another device or
+	// driver. Call before the first build(), returns whether the data was used.
+	bool create_cache(const std::vector<char> &data, const vk::PhysicalDeviceProperties &properties);
+	[[nodiscard]] std::vector<uint8_t> cache_data() const;
+
+	// blend is ignored when blending is dynamic, pass baked_blend() of the draw state
+	[[nodiscard]] GraphicsPipeline build(
+		const ShaderSource &source,
+		const ShaderPermutation &permutation,
+		bool blend,
+		vk::SampleCountFlagBits samples = vk::SampleCountFlagBits::e1);
+
+	// The part of a draw state which has to be compiled into the pipeline on this device
+	[[nodiscard]] bool baked_blend(const DrawState &state) const { return !dynamic_blend && state.blend; }
+
+	// Sets every dynamic state the pipelines declare, call after binding one
+	void set_draw_state(const raii::CommandBuffer &command_buffer, const DrawState &state) const;
+
+	// Drops cached shader libraries of every shader but the given one, e.g. after a hot reload. Builds of older
+	// shaders still running afterwards do not cache theirs.
+	void evict_shader_libraries(uint64_t keep_shader_id);
+
+	[[nodiscard]] bool uses_libraries() const { return use_libraries; }
+	[[nodiscard]] bool has_dynamic_blend() const { return dynamic_blend; }
+	[[nodiscard]] size_t library_count();
+};
@@ -0,0 +1,83 @@
+#include "PipelineLayoutCache.h"
+
+PipelineLayoutCache::PipelineLayoutCache(const raii::Device &_device):
+	device(_device)
+{
+
+}
+
+PipelineLayoutCache::SetLayoutKey PipelineLayoutCache::key_of(
+	const std::vector<vk::DescriptorSetLayoutBinding> &bindings
+) {
+	SetLayoutKey key;
+	key.reserve(bindings.size());
+	for (const auto &binding : bindings) {
+		key.push_back({
+			binding.binding,
+			static_cast<uint32_t>(binding.descriptorType),
+			binding.descriptorCount,
+			static_cast<uint32_t>(binding.stageFlags)
+		});
+	}
+	return key;
+}
+
+vk::DescriptorSetLayout PipelineLayoutCache::set_layout(
+	const SetLayoutKey &key,
+	const std::vector<vk::DescriptorSetLayoutBinding> &bindings
+) {
+	if (const auto it = set_layouts.find(key); it != set_layouts.end()) return *it->second;
+
+	const vk::DescriptorSetLayoutCreateInfo create_info = {
+		{},
+		static_cast<uint32_t>(bindings.size()),
+		bindings.data()
+	};
+
+	return *set_layouts.emplace(key, raii::DescriptorSetLayout{device, create_info}).first->second;
+}
+
+vk::PipelineLayout PipelineLayoutCache::get(const spirv::PipelineInterface &interface) {
+	std::lock_guard lock{mutex};
+
+	// The key is every set's bindings followed by the push constant ranges, with set sizes as separators
+	PipelineLayoutKey key;
+	std::vector<vk::DescriptorSetLayout> layouts;
+
+	for (const auto &set : interface.sets) {
+		const SetLayoutKey set_key = key_of(set);
+		layouts.push_back(set_layout(set_key, set));
+
+		key.push_back(static_cast<uint32_t>(set_key.size()));
+		for (const auto &binding : set_key) key.insert(key.end(), binding.begin(), binding.end());
+	}
+
+	key.push_back(static_cast<uint32_t>(interface.push_constants.size()));
+	for (const auto &range : interface.push_constants) {
+		key.push_back(static_cast<uint32_t>(range.stageFlags));
+		key.push_back(range.offset);
+		key.push_back(range.size);
+	}
+
+	if (const auto it = pipeline_layouts.find(key); it != pipeline_layouts.end()) return *it->second;
+
+	const vk::PipelineLayoutCreateInfo create_info = {
+		{},
+		static_cast<uint32_t>(layouts.size()),
+		layouts.data(),
+		static_cast<uint32_t>(interface.push_constants.size()),
+		interface.push_constants.data()
+	};
+
+	return *pipeline_layouts.emplace(key, raii::PipelineLayout{device, create_info}).first->second;
+}
+
+size_t PipelineLayoutCache::set_layout_count() {
+	std::lock_guard lock{mutex};
+	return set_layouts.size();
+}
+
+size_t PipelineLayoutCache::pipeline_layout_count() {
+	std::lock_guard lock{mutex};
+	return pipeline_layouts.size();
+}
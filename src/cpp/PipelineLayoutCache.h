@@ -0,0 +1,34 @@
+#pragma once
+#include <array>
+#include <map>
+#include <mutex>
+#include <vector>
+
+#include <vulkan/vulkan_raii.hpp>
+
+#include "SpirvReflection.h"
+
+namespace raii = vk::raii;
+
+// Owns descriptor set layouts and pipeline layouts, handing out the same object for identical descriptions.
+// Safe to use from several threads at once.
+class PipelineLayoutCache {
+	using SetLayoutKey = std::vector<std::array<uint32_t, 4>>;
+	using PipelineLayoutKey = std::vector<uint32_t>;
+
+	const raii::Device &device;
+	std::mutex mutex;
+	std::map<SetLayoutKey, raii::DescriptorSetLayout> set_layouts;
+	std::map<PipelineLayoutKey, raii::PipelineLayout> pipeline_layouts;
+
+	static SetLayoutKey key_of(const std::vector<vk::DescriptorSetLayoutBinding> &bindings);
+	vk::DescriptorSetLayout set_layout(const SetLayoutKey &key, const std::vector<vk::DescriptorSetLayoutBinding> &bindings);
+
+public:
+	explicit PipelineLayoutCache(const raii::Device &_device);
+
+	[[nodiscard]] vk::PipelineLayout get(const spirv::PipelineInterface &interface);
+
+	[[nodiscard]] size_t set_layout_count();
+	[[nodiscard]] size_t pipeline_layout_count();
+};
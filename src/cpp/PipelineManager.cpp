@@ -0,0 +1,119 @@
+#include "PipelineManager.h"
+
+#include <stdexcept>
+
+#include "Log.h"
+#include "Trace.h"
+
+PipelineManager::PipelineManager(const unsigned int thread_count) {
+	workers.reserve(thread_count);
+	for (unsigned int i = 0; i < thread_count; i++) {
+		workers.emplace_back([this, i](const std::stop_token &stop) {
+			trace::name_thread("Pipelines " + std::to_string(i));
+			work(stop);
+		});
+	}
+}
+
+PipelineManager::~PipelineManager() {
+	for (auto &worker : workers) worker.request_stop();
+	queue_changed.notify_all();
+	workers.clear(); // Joins before the slots go away
+}
+
+void PipelineManager::work(const std::stop_token &stop) {
+	while (true) {
+		Job job;
+		{
+			std::unique_lock lock{mutex};
+			if (!queue_changed.wait(lock, stop, [this] { return !jobs.empty(); })) return;
+			job = std::move(jobs.front());
+			jobs.pop_front();
+			if (slots[job.handle].generation != job.generation) continue; // Superseded while queued
+		}
+
+		// vkCreateGraphicsPipelines is free-threaded, only the bookkeeping needs the lock
+		std::optional<GraphicsPipeline> compiled;
+		std::string error;
+		try {
+			TRACE_ZONE("build pipeline");
+			compiled = job.build();
+		} catch (const std::exception &e) {
+			error = e.what();
+		}
+
+		std::lock_guard lock{mutex};
+		Slot &slot = slots[job.handle];
+		if (slot.generation != job.generation) continue;
+		slot.compiled = std::move(compiled);
+		slot.error = std::move(error);
+		if (!slot.compiled && slot.error.empty()) slot.error = "unknown error";
+	}
+}
+
+void PipelineManager::schedule(const Handle handle, Builder build) {
+	{
+		std::lock_guard lock{mutex};
+		Slot &slot = slots[handle];
+		slot.generation++;
+		slot.compiled.reset();
+		slot.error.clear();
+		jobs.push_back({handle, slot.generation, std::move(build)});
+	}
+	queue_changed.notify_one();
+}
+
+PipelineManager::Handle PipelineManager::compile_now(const std::string &name, const Builder &build) {
+	GraphicsPipeline pipeline = build();
+
+	std::lock_guard lock{mutex};
+	Slot &slot = slots.emplace_back();
+	slot.name = name;
+	slot.pipeline = std::move(pipeline);
+	slot.ready = true;
+	return slots.size() - 1;
+}
+
+PipelineManager::Handle PipelineManager::request(const std::string &name, Builder build) {
+	Handle handle;
+	{
+		std::lock_guard lock{mutex};
+		slots.emplace_back().name = name;
+		handle = slots.size() - 1;
+	}
+	schedule(handle, std::move(build));
+	return handle;
+}
+
+void PipelineManager::rebuild(const Handle handle, Builder build) {
+	schedule(handle, std::move(build));
+}
+
+void PipelineManager::set_fallback(const Handle handle) {
+	if (!ready(handle)) throw std::runtime_error("Fallback pipeline has to be ready!");
+	fallback = handle;
+}
+
+void PipelineManager::collect() {
+	std::lock_guard lock{mutex};
+	for (Slot &slot : slots) {
+		if (slot.compiled) {
+			slot.pipeline = std::move(*slot.compiled);
+			slot.compiled.reset();
+			slot.ready = true;
+		} else if (!slot.error.empty()) {
+			// A failed rebuild leaves the previous pipeline (if any) in place
+			logging::error("Failed to compile pipeline {}: {}", slot.name, slot.error);
+			slot.error.clear();
+		}
+	}
+}
+
+const GraphicsPipeline &PipelineManager::get(const Handle handle) const {
+	const Slot &slot = slots[handle];
+	return slot.ready ? slot.pipeline : slots[fallback].pipeline;
+}
+
+bool PipelineManager::ready(const Handle handle) const {
+	return slots[handle].ready;
+}
@@ -0,0 +1,78 @@
+#pragma once
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <vulkan/vulkan_raii.hpp>
+
+namespace raii = vk::raii;
+
+struct GraphicsPipeline {
+	raii::Pipeline pipeline{nullptr};
+	vk::PipelineLayout layout; // Owned by PipelineLayoutCache
+	vk::PushConstantRange push_constants; // Size 0 if the shaders declare none
+	vk::SampleCountFlagBits samples = vk::SampleCountFlagBits::e1; // The attachments it can render to
+};
+
+// Compiles pipelines on worker threads. Handles are returned immediately and resolve to the fallback
+// pipeline until their own one has been compiled and collected.
+class PipelineManager {
+public:
+	using Handle = size_t;
+	using Builder = std::function<GraphicsPipeline()>;
+
+private:
+	struct Slot {
+		std::string name;
+		uint64_t generation = 0;            // Bumped by every (re)build request, stale results are dropped
+		std::optional<GraphicsPipeline> compiled; // Finished on a worker, waiting for collect()
+		std::string error;
+		GraphicsPipeline pipeline;          // What get() returns, only touched by the owning thread
+		bool ready = false;
+	};
+
+	struct Job {
+		Handle handle;
+		uint64_t generation;
+		Builder build;
+	};
+
+	std::mutex mutex;
+	std::condition_variable_any queue_changed;
+	std::deque<Job> jobs;
+	std::deque<Slot> slots;
+	Handle fallback = 0;
+	std::vector<std::jthread> workers;
+
+	void work(const std::stop_token &stop);
+	void schedule(Handle handle, Builder build);
+
+public:
+	explicit PipelineManager(unsigned int thread_count = std::max(2u, std::thread::hardware_concurrency()) - 1);
+	PipelineManager(const PipelineManager &) = delete;
+	PipelineManager &operator=(const PipelineManager &) = delete;
+	~PipelineManager();
+
+	// Compiles on the calling thread, for pipelines that have to exist before the first frame
+	Handle compile_now(const std::string &name, const Builder &build);
+	// Queues a compile and returns at once
+	Handle request(const std::string &name, Builder build);
+	// Queues a recompile, the current pipeline stays in use until the new one is collected
+	void rebuild(Handle handle, Builder build);
+
+	// Drawn in place of pipelines which are not ready (or failed to compile). Must be ready itself.
+	void set_fallback(Handle handle);
+
+	// Publishes finished compiles. Call between frames, once the GPU is done with the pipelines being replaced.
+	void collect();
+
+	[[nodiscard]] const GraphicsPipeline &get(Handle handle) const;
+	[[nodiscard]] bool ready(Handle handle) const;
+	[[nodiscard]] unsigned int thread_count() const { return static_cast<unsigned int>(workers.size()); }
+};
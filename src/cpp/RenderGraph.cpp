@@ -0,0 +1,385 @@
+#include "RenderGraph.h"
+
+#include <stdexcept>
+
+namespace {
+	struct UsageInfo {
+		vk::ImageLayout layout;
+		vk::PipelineStageFlags2 stages;
+		vk::AccessFlags2 read_access;
+		vk::AccessFlags2 write_access;
+		vk::ImageUsageFlags image_usage;
+	};
+
+	UsageInfo info_of(const RenderGraph::Usage usage) {
+		using Usage = RenderGraph::Usage;
+		using Stage = vk::PipelineStageFlagBits2;
+		using Access = vk::AccessFlagBits2;
+
+		switch (usage) {
+		case Usage::ColorAttachment:
+			return {
+				vk::ImageLayout::eColorAttachmentOptimal,
+				Stage::eColorAttachmentOutput,
+				Access::eColorAttachmentRead,
+				Access::eColorAttachmentRead | Access::eColorAttachmentWrite,
+				vk::ImageUsageFlagBits::eColorAttachment
+			};
+		case Usage::DepthAttachment:
+			return {
+				vk::ImageLayout::eDepthAttachmentOptimal,
+				Stage::eEarlyFragmentTests | Stage::eLateFragmentTests,
+				Access::eDepthStencilAttachmentRead,
+				Access::eDepthStencilAttachmentRead | Access::eDepthStencilAttachmentWrite,
+				vk::ImageUsageFlagBits::eDepthStencilAttachment
+			};
+		case Usage::Sampled:
+			return {
+				vk::ImageLayout::eShaderReadOnlyOptimal,
+				Stage::eFragmentShader,
+				Access::eShaderSampledRead,
+				Access::eShaderSampledRead,
+				vk::ImageUsageFlagBits::eSampled
+			};
+		case Usage::TransferSource:
+			return {
+				vk::ImageLayout::eTransferSrcOptimal,
+				Stage::eTransfer,
+				Access::eTransferRead,
+				Access::eTransferRead,
+				vk::ImageUsageFlagBits::eTransferSrc
+			};
+		case Usage::TransferDestination:
+			return {
+				vk::ImageLayout::eTransferDstOptimal,
+				Stage::eTransfer,
+				Access::eTransferWrite,
+				Access::eTransferWrite,
+				vk::ImageUsageFlagBits::eTransferDst
+			};
+		case Usage::Present:
+			// Presentation waits on a semaphore, which already covers all prior work
+			return {
+				vk::ImageLayout::ePresentSrcKHR,
+				Stage::eBottomOfPipe,
+				Access::eNone,
+				Access::eNone,
+				{}
+			};
+		}
+		throw std::runtime_error("Unknown render graph usage");
+	}
+
+	// Usages that let an image live in lazily allocated memory
+	constexpr vk::ImageUsageFlags attachment_usages =
+		vk::ImageUsageFlagBits::eColorAttachment
+		| vk::ImageUsageFlagBits::eDepthStencilAttachment
+		| vk::ImageUsageFlagBits::eInputAttachment;
+}
+
+
+
+RenderGraph::Pass::Pass(std::string _name):
+	name(std::move(_name))
+{
+
+}
+
+RenderGraph::Pass &RenderGraph::Pass::use(const Resource resource, const Usage usage, const bool write) {
+	for (const auto &existing : uses) {
+		if (existing.resource == resource) {
+			throw std::runtime_error("Render pass " + name + " uses a resource twice");
+		}
+	}
+	uses.push_back({resource, usage, write});
+	return *this;
+}
+
+RenderGraph::Pass &RenderGraph::Pass::read(const Resource resource, const Usage usage) {
+	return use(resource, usage, false);
+}
+
+RenderGraph::Pass &RenderGraph::Pass::write(const Resource resource, const Usage usage) {
+	return use(resource, usage, true);
+}
+
+RenderGraph::Pass &RenderGraph::Pass::keep() {
+	side_effects = true;
+	return *this;
+}
+
+RenderGraph::Pass &RenderGraph::Pass::execute(Record _record) {
+	record = std::move(_record);
+	return *this;
+}
+
+
+
+RenderGraph::RenderGraph(TransientAllocator &_allocator):
+	allocator(&_allocator)
+{
+
+}
+
+RenderGraph::Resource RenderGraph::import_image(
+	std::string name,
+	const vk::Image image,
+	const vk::ImageView view,
+	const vk::ImageAspectFlags aspect,
+	const vk::ImageLayout layout,
+	const vk::PipelineStageFlags2 ready_stages
+) {
+	images.push_back({
+		std::move(name),
+		image,
+		view,
+		aspect,
+		{layout, ready_stages, vk::AccessFlagBits2::eNone, vk::PipelineStageFlagBits2::eNone},
+		std::nullopt,
+		std::nullopt
+	});
+	compiled = false;
+	return static_cast<Resource>(images.size() - 1);
+}
+
+RenderGraph::Resource RenderGraph::create_image(std::string name, const ImageDescription &description) {
+	if (!allocator) throw std::runtime_error("Render graph without an allocator can not create image " + name);
+
+	images.push_back({
+		std::move(name),
+		nullptr,
+		nullptr,
+		description.aspect,
+		{vk::ImageLayout::eUndefined, vk::PipelineStageFlagBits2::eNone, vk::AccessFlagBits2::eNone, vk::PipelineStageFlagBits2::eNone},
+		std::nullopt,
+		description
+	});
+	compiled = false;
+	return static_cast<Resource>(images.size() - 1);
+}
+
+RenderGraph::Pass &RenderGraph::add_pass(std::string name) {
+	compiled = false;
+	return passes.emplace_back(std::move(name));
+}
+
+void RenderGraph::output(const Resource resource, const Usage usage) {
+	if (images.at(resource).transient) {
+		throw std::runtime_error("Transient image " + images[resource].name + " can not be a graph output");
+	}
+	images[resource].output = usage;
+	compiled = false;
+}
+
+std::vector<bool> RenderGraph::live_passes() const {
+	std::vector<bool> needed(images.size(), false);
+	for (size_t i = 0; i < images.size(); ++i) needed[i] = images[i].output.has_value();
+
+	// Walking backwards, a pass lives if it writes something a later live pass or an output needs.
+	// Everything a live pass touches is needed before it, writes included since attachments may be loaded.
+	std::vector<bool> live(passes.size(), false);
+	for (size_t i = passes.size(); i-- > 0;) {
+		const Pass &pass = passes[i];
+
+		bool contributes = pass.side_effects;
+		for (const auto &use : pass.uses) contributes |= use.write && needed[use.resource];
+		if (!contributes) continue;
+
+		live[i] = true;
+		for (const auto &use : pass.uses) needed[use.resource] = true;
+	}
+	return live;
+}
+
+std::vector<TransientAllocator::Request> RenderGraph::transient_requests(
+	const std::vector<size_t> &live,
+	std::vector<Resource> &resources
+) const {
+	std::vector<TransientAllocator::Request> requests;
+	std::vector<std::optional<size_t>> request_of(images.size());
+
+	for (size_t step = 0; step < live.size(); ++step) {
+		for (const auto &use : passes[live[step]].uses) {
+			const Image &image = images[use.resource];
+			if (!image.transient) continue;
+
+			auto &index = request_of[use.resource];
+			if (!index) {
+				index = requests.size();
+				requests.push_back({
+					image.transient->format,
+					image.transient->extent,
+					image.transient->usage,
+					image.transient->samples,
+					image.transient->aspect,
+					step,
+					step
+				});
+				resources.push_back(use.resource);
+			}
+
+			requests[*index].usage |= info_of(use.usage).image_usage;
+			requests[*index].last = step;
+		}
+	}
+
+	for (auto &request : requests) {
+		if (!(request.usage & ~attachment_usages)) request.usage |= vk::ImageUsageFlagBits::eTransientAttachment;
+	}
+	return requests;
+}
+
+void RenderGraph::transition(
+	const Resource resource,
+	State &state,
+	const Usage usage,
+	const bool write,
+	std::vector<vk::ImageMemoryBarrier2> &out
+) const {
+	const UsageInfo info = info_of(usage);
+	const vk::AccessFlags2 access = write ? info.write_access : info.read_access;
+	const bool layout_change = state.layout != info.layout;
+
+	vk::PipelineStageFlags2 src_stages;
+	vk::AccessFlags2 src_access;
+
+	if (layout_change || write) {
+		// The last write and every read since have to finish first
+		src_stages = state.write_stages | state.read_stages;
+		src_access = state.write_access;
+	} else {
+		// A read only waits for the last write, once per stage
+		if ((state.read_stages & info.stages) == info.stages) return;
+		state.read_stages |= info.stages;
+		if (!state.write_stages) return;
+		src_stages = state.write_stages;
+		src_access = state.write_access;
+	}
+
+	if (!layout_change && !src_stages) {
+		state.write_stages = info.stages;
+		state.write_access = info.write_access;
+		return;
+	}
+
+	out.push_back({
+		src_stages,
+		src_access,
+		info.stages,
+		access,
+		state.layout,
+		info.layout,
+		vk::QueueFamilyIgnored,
+		vk::QueueFamilyIgnored,
+		images[resource].image,
+		vk::ImageSubresourceRange{
+			images[resource].aspect,
+			0,
+			vk::RemainingMipLevels,
+			0,
+			vk::RemainingArrayLayers
+		}
+	});
+
+	if (layout_change || write) {
+		// A layout transition counts as a write every later use has to wait for
+		state.layout = info.layout;
+		state.write_stages = info.stages;
+		state.write_access = write ? info.write_access : vk::AccessFlagBits2::eNone;
+		state.read_stages = write ? vk::PipelineStageFlagBits2::eNone : info.stages;
+	}
+}
+
+void RenderGraph::compile() {
+	steps.clear();
+	final_barriers.clear();
+
+	const std::vector<bool> is_live = live_passes();
+	std::vector<size_t> live;
+	for (size_t i = 0; i < passes.size(); ++i) {
+		if (is_live[i]) live.push_back(i);
+	}
+
+	// The resource of every request, and the request of every transient image a live pass uses
+	std::vector<Resource> resources;
+	const std::vector<TransientAllocator::Request> requests = transient_requests(live, resources);
+	std::vector<std::optional<size_t>> request_of(images.size());
+
+	for (auto &image : images) {
+		if (!image.transient) continue;
+		image.image = nullptr;
+		image.view = nullptr;
+	}
+	const std::vector<TransientAllocator::Allocation> *allocations = nullptr;
+	if (!requests.empty()) {
+		allocations = &allocator->realize(requests);
+		for (size_t i = 0; i < requests.size(); ++i) {
+			images[resources[i]].image = (*allocations)[i].image;
+			images[resources[i]].view = (*allocations)[i].view;
+			request_of[resources[i]] = i;
+		}
+	}
+
+	std::vector<State> states;
+	states.reserve(images.size());
+	for (const auto &image : images) states.push_back(image.initial);
+
+	for (size_t step = 0; step < live.size(); ++step) {
+		Step compiled_step = {live[step], {}};
+
+		for (const auto &use : passes[live[step]].uses) {
+			// An aliased image's first use waits for everything that used the memory before it
+			if (const auto request = request_of[use.resource]; request && requests[*request].first == step) {
+				State &state = states[use.resource];
+				for (const size_t alias : (*allocations)[*request].aliases) {
+					const State &previous = states[resources[alias]];
+					state.write_stages |= previous.write_stages | previous.read_stages;
+					state.write_access |= previous.write_access;
+				}
+			}
+			transition(use.resource, states[use.resource], use.usage, use.write, compiled_step.barriers);
+		}
+		steps.push_back(std::move(compiled_step));
+	}
+
+	for (Resource resource = 0; resource < images.size(); ++resource) {
+		if (!images[resource].output) continue;
+		transition(resource, states[resource], *images[resource].output, false, final_barriers);
+	}
+
+	compiled = true;
+}
+
+void RenderGraph::execute(const raii::CommandBuffer &command_buffer, const Marker &marker) const {
+	if (!compiled) throw std::runtime_error("Render graph executed without being compiled");
+
+	const auto barrier = [&](const std::vector<vk::ImageMemoryBarrier2> &barriers) {
+		if (barriers.empty()) return;
+
+		const vk::DependencyInfo dependency_info = {
+			{},
+			0,
+			nullptr,
+			0,
+			nullptr,
+			static_cast<uint32_t>(barriers.size()),
+			barriers.data()
+		};
+		command_buffer.pipelineBarrier2(dependency_info);
+	};
+
+	for (const auto &step : steps) {
+		const Pass &pass = passes[step.pass];
+		if (marker) marker(command_buffer, pass.name, false);
+		barrier(step.barriers);
+		if (pass.record) pass.record(command_buffer);
+		if (marker) marker(command_buffer, pass.name, true);
+	}
+	barrier(final_barriers);
+}
+
+size_t RenderGraph::barrier_count() const {
+	size_t count = final_barriers.size();
+	for (const auto &step : steps) count += step.barriers.size();
+	return count;
+}
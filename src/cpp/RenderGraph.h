@@ -0,0 +1,137 @@
+#pragma once
+#include <functional>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <vulkan/vulkan_raii.hpp>
+
+#include "TransientAllocator.h"
+
+namespace raii = vk::raii;
+
+// Frame graph of passes over images. Passes declare what they read and write, compile() culls passes that do not
+// contribute to an output and derives one batched pipelineBarrier2 per pass from the declared usages.
+// Passes run in declaration order, which is already a valid order of the dependencies they declare.
+// Images created by the graph live only within it and get their memory from a TransientAllocator.
+class RenderGraph {
+public:
+	using Resource = uint32_t;
+	using Record = std::function<void(const raii::CommandBuffer &)>;
+	// Called around the commands of every pass that runs, e.g. to write timestamps
+	using Marker = std::function<void(const raii::CommandBuffer &, const std::string &pass, bool end)>;
+
+	struct ImageDescription {
+		vk::Format format;
+		vk::Extent2D extent;
+		vk::ImageAspectFlags aspect;
+		vk::SampleCountFlagBits samples = vk::SampleCountFlagBits::e1;
+		vk::ImageUsageFlags usage = {}; // On top of what the passes using the image declare
+	};
+
+	enum class Usage {
+		ColorAttachment,    // Also the resolve target of a multisampled color attachment
+		DepthAttachment,
+		Sampled,            // Read in a fragment shader
+		TransferSource,
+		TransferDestination,
+		Present,
+	};
+
+	class Pass {
+		friend class RenderGraph;
+
+		struct Use {
+			Resource resource;
+			Usage usage;
+			bool write;
+		};
+
+		std::string name;
+		std::vector<Use> uses;
+		Record record;
+		bool side_effects = false;
+
+		Pass &use(Resource resource, Usage usage, bool write);
+
+	public:
+		explicit Pass(std::string _name);
+
+		Pass &read(Resource resource, Usage usage);
+		Pass &write(Resource resource, Usage usage);
+		// Never culled, for passes whose results leave the graph some other way (e.g. a buffer readback)
+		Pass &keep();
+		Pass &execute(Record _record);
+	};
+
+private:
+	struct State {
+		vk::ImageLayout layout;
+		vk::PipelineStageFlags2 write_stages;
+		vk::AccessFlags2 write_access;
+		vk::PipelineStageFlags2 read_stages; // Reads since the last write, already synchronised with it
+	};
+
+	struct Image {
+		std::string name;
+		vk::Image image;
+		vk::ImageView view;
+		vk::ImageAspectFlags aspect;
+		State initial;
+		std::optional<Usage> output;
+		std::optional<ImageDescription> transient;
+	};
+
+	struct Step {
+		size_t pass;
+		std::vector<vk::ImageMemoryBarrier2> barriers;
+	};
+
+	TransientAllocator *allocator = nullptr;
+	std::vector<Image> images;
+	std::vector<Pass> passes;
+
+	std::vector<Step> steps;
+	std::vector<vk::ImageMemoryBarrier2> final_barriers;
+	bool compiled = false;
+
+	[[nodiscard]] std::vector<bool> live_passes() const;
+	// Lifetimes and usages of the transient images the live passes touch, one request per image
+	[[nodiscard]] std::vector<TransientAllocator::Request> transient_requests(
+		const std::vector<size_t> &live,
+		std::vector<Resource> &resources) const;
+	void transition(Resource resource, State &state, Usage usage, bool write, std::vector<vk::ImageMemoryBarrier2> &out) const;
+
+public:
+	RenderGraph() = default;
+	explicit RenderGraph(TransientAllocator &_allocator);
+
+	// ready_stages: where the image becomes available, e.g. the wait stage of the acquire semaphore
+	Resource import_image(
+		std::string name,
+		vk::Image image,
+		vk::ImageView view,
+		vk::ImageAspectFlags aspect,
+		vk::ImageLayout layout = vk::ImageLayout::eUndefined,
+		vk::PipelineStageFlags2 ready_stages = vk::PipelineStageFlagBits2::eNone);
+
+	// Contents start out undefined every time the graph runs. Needs the graph to have an allocator.
+	Resource create_image(std::string name, const ImageDescription &description);
+
+	// Passes are stored by value, the reference is valid until the next add_pass()
+	Pass &add_pass(std::string name);
+
+	// Keeps the resource's producers alive and leaves it in the layout of the given usage
+	void output(Resource resource, Usage usage);
+	void present(Resource resource) { output(resource, Usage::Present); }
+
+	void compile();
+	void execute(const raii::CommandBuffer &command_buffer, const Marker &marker = {}) const;
+
+	// Transient images only have a handle once the graph is compiled, and none if no live pass uses them
+	[[nodiscard]] vk::Image image(Resource resource) const { return images[resource].image; }
+	[[nodiscard]] vk::ImageView view(Resource resource) const { return images[resource].view; }
+	[[nodiscard]] size_t pass_count() const { return steps.size(); }
+	[[nodiscard]] size_t culled_count() const { return passes.size() - steps.size(); }
+	[[nodiscard]] size_t barrier_count() const;
+};
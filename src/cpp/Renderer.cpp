@@ -1,5 +1,6 @@
 #include "Renderer.h"
 
+#include <array>
 #include <bitset>
 #include <fstream>
 #include <iostream>
@@ -7,23 +8,21 @@
 #include <map>
 #include <set>
 #include <chrono>
+#include <cmath>
+#include <sstream>
 
+#include "Log.h"
+#include "Trace.h"
 #include "text_formatting.h"
 
 namespace raii = vk::raii;
 namespace ch = std::chrono;
 
 
-bool Renderer::has_extensions(const raii::PhysicalDevice &device) const {
-	const std::vector<vk::ExtensionProperties> available_extensions = device.enumerateDeviceExtensionProperties();
-
-	std::set<std::string> required_extensions{device_extensions.begin(), device_extensions.end()};
-
-	for (auto extension : available_extensions) {
-		required_extensions.erase(extension.extensionName);
-	}
-
-	return required_extensions.empty();
+bool Renderer::has_extensions(const DeviceCapabilities &device) const {
+	return std::ranges::all_of(device_extensions, [&device](const char *extension) {
+		return device.has_extension(extension);
+	});
 }
 
 
@@ -40,9 +39,9 @@ Renderer::SwapchainSupportDetails Renderer::query_swap_chain_support(const raii:
 
 
 
-short Renderer::rank_score(const raii::PhysicalDevice &device) const {
-	const vk::PhysicalDeviceProperties properties = device.getProperties();
-	const vk::PhysicalDeviceFeatures features = device.getFeatures();
+short Renderer::rank_score(const DeviceCapabilities &device) const {
+	const vk::PhysicalDeviceProperties &properties = device.properties;
+	const vk::PhysicalDeviceFeatures &features = device.features;
 
 	short score = 0;
 
@@ -57,13 +56,32 @@ short Renderer::rank_score(const raii::PhysicalDevice &device) const {
 	if (!features.geometryShader) return INT16_MIN;
 	if (!has_extensions(device)) return INT16_MIN;
 	if (properties.apiVersion < vk::ApiVersion13) return INT16_MIN;
+	// What create_logical_device() enables
+	if (!device.vulkan_11_features.shaderDrawParameters) return INT16_MIN;
+	if (!device.vulkan_12_features.bufferDeviceAddress) return INT16_MIN;
+	if (!device.vulkan_13_features.synchronization2 || !device.vulkan_13_features.dynamicRendering) return INT16_MIN;
 
-	const SwapchainSupportDetails swap_chain_support = query_swap_chain_support(device);
+	// The surface is checked by choose_physical_device(), this runs before there is one
+	return score;
+}
 
-	if (swap_chain_support.formats.empty()) return INT16_MIN;
-	if (swap_chain_support.presentModes.empty()) return INT16_MIN;
 
-	return score;
+
+std::vector<Renderer::DeviceCandidate> Renderer::rank_devices() {
+	std::vector<raii::PhysicalDevice> physical_devices = instance.enumeratePhysicalDevices();
+	DeviceCapabilityCache cache{DEVICE_CACHE_FILE};
+
+	std::vector<DeviceCandidate> candidates;
+	candidates.reserve(physical_devices.size());
+	for (raii::PhysicalDevice &device : physical_devices) {
+		DeviceCapabilities device_capabilities = cache.get(device);
+		const short score = rank_score(device_capabilities);
+		candidates.push_back({std::move(device), std::move(device_capabilities), score});
+	}
+
+	cached_capabilities = cache.hit_count();
+	if (!cache.save()) logging::warning("Failed to write {}", DEVICE_CACHE_FILE);
+	return candidates;
 }
 
 
@@ -71,19 +89,23 @@ short Renderer::rank_score(const raii::PhysicalDevice &device) const {
 void Renderer::choose_physical_device() {
 	wnd::begin_section("Physical device: ");
 
-	std::vector<raii::PhysicalDevice> physical_devices = instance.enumeratePhysicalDevices();
+	std::vector<DeviceCandidate> candidates = device_candidates.get();
 
-	if (physical_devices.empty()) {
+	if (candidates.empty()) {
 		wnd::print("None");
 		throw std::runtime_error("failed to find GPUs with Vulkan support!");
 	}
 
-	std::multimap<short, raii::PhysicalDevice &> ranked_devices;
+	std::multimap<short, DeviceCandidate &> ranked_devices;
 
-	for (raii::PhysicalDevice& device: physical_devices) {
-		const short score = rank_score(device);
-		if (score == INT16_MIN) continue;
-		ranked_devices.insert(std::pair<short, raii::PhysicalDevice&>(-score, device));
+	for (DeviceCandidate &candidate : candidates) {
+		if (candidate.score == INT16_MIN) continue;
+
+		const SwapchainSupportDetails swap_chain_support = query_swap_chain_support(candidate.device);
+		if (swap_chain_support.formats.empty()) continue;
+		if (swap_chain_support.presentModes.empty()) continue;
+
+		ranked_devices.insert(std::pair<short, DeviceCandidate &>(-candidate.score, candidate));
 	}
 
 	if (ranked_devices.empty()) {
@@ -94,19 +116,23 @@ void Renderer::choose_physical_device() {
 
 	bool first = true;
 
-	for (std::pair<const short, const raii::PhysicalDevice &> device: ranked_devices) {
+	for (const auto &[score, candidate] : ranked_devices) {
 		wnd::print(
 			std::string{first ? ">T" : " T"}
-			+ std::to_string(static_cast<int>(device.second.getProperties().deviceType))
-			+ ", " + wnd::set_length(std::to_string(-device.first), 5) + " points - "
-			+ std::string{device.second.getProperties().deviceName}
+			+ std::to_string(static_cast<int>(candidate.capabilities.properties.deviceType))
+			+ ", " + wnd::set_length(std::to_string(-score), 5) + " points - "
+			+ std::string{candidate.capabilities.properties.deviceName}
 			+ std::string{first ? "<" : ""});
 		first = false;
 	}
 
 	wnd::end_frame();
 
-	physical_device = std::move(ranked_devices.begin()->second);
+	wnd::print("Capabilities: " + std::to_string(cached_capabilities) + " of " + std::to_string(candidates.size())
+		+ " from " + DEVICE_CACHE_FILE);
+
+	physical_device = std::move(ranked_devices.begin()->second.device);
+	capabilities = std::move(ranked_devices.begin()->second.capabilities);
 
 	wnd::print();
 }
@@ -213,13 +239,12 @@ void Renderer::create_vulkan_instance() {
 
 
 void Renderer::create_window() {
-	glfwInit();
-
 	glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
 	glfwWindowHint(GLFW_RESIZABLE, false);
 
 	window = glfwCreateWindow(WIDTH, HEIGHT, "LavaChicken main window", nullptr, nullptr);
-	wnd::begin("LavaChicken debug console", wnd::all_buttons, 64);
+	glfwSetWindowUserPointer(window, this);
+	glfwSetKeyCallback(window, key_callback);
 	wnd::begin_section("Window:");
 	wnd::begin_frame("Requested:");
 	wnd::print(std::string{"Width:   "} + std::to_string(WIDTH));
@@ -271,10 +296,8 @@ void Renderer::create_window() {
 
 void Renderer::get_queue_indices() {
 	wnd::begin_section("Queues: ");
-	auto queue_family_properties = physical_device.getQueueFamilyProperties();
-
 	unsigned int i = 0;
-	for (auto property: queue_family_properties) {
+	for (const vk::QueueFamilyProperties &property : capabilities.queue_families) {
 		wnd::begin_frame(std::to_string(i));
 
 		vk::QueueFlags flags = property.queueFlags;
@@ -332,9 +355,39 @@ void Renderer::create_logical_device() {
 	}
 	wnd::end_frame();
 
+	std::vector<const char *> extensions = device_extensions;
+
+	// Optional: compile pipeline parts once and link them instead of creating every pipeline whole
+	pipeline_library_supported = capabilities.graphics_pipeline_library;
+
+	// Optional: toggle blending per draw instead of per pipeline
+	dynamic_blend_supported = capabilities.dynamic_blend_enable;
+
+	// Optional: GPU zones of the trace on the CPU clock
+	calibrated_timestamps_supported = GpuTrace::calibration_supported(capabilities);
+
+	wnd::begin_frame("Optional extensions:");
+	if (pipeline_library_supported) {
+		extensions.push_back(vk::KHRPipelineLibraryExtensionName);
+		extensions.push_back(vk::EXTGraphicsPipelineLibraryExtensionName);
+	}
+	if (dynamic_blend_supported) extensions.push_back(vk::EXTExtendedDynamicState3ExtensionName);
+	if (calibrated_timestamps_supported) extensions.push_back(vk::EXTCalibratedTimestampsExtensionName);
+	wnd::print(std::string(pipeline_library_supported ? "+ " : "- ") + vk::EXTGraphicsPipelineLibraryExtensionName);
+	wnd::print(std::string(dynamic_blend_supported ? "+ " : "- ") + vk::EXTExtendedDynamicState3ExtensionName);
+	wnd::print(std::string(calibrated_timestamps_supported ? "+ " : "- ") + vk::EXTCalibratedTimestampsExtensionName);
+	wnd::end_frame();
+
+	vk::PhysicalDeviceExtendedDynamicState3FeaturesEXT extended_dynamic_state_3_features{};
+	extended_dynamic_state_3_features.extendedDynamicState3ColorBlendEnable = true;
+
+	// Shaders read per-instance data through buffer device addresses
+	vk::PhysicalDeviceVulkan12Features vulkan_12_features{};
+	vulkan_12_features.bufferDeviceAddress = true;
+
 	// Create a chain of feature structures
 	vk::StructureChain featureChain = {
-		physical_device.getFeatures2(), // vk::PhysicalDeviceFeatures2 (empty for now)
+		vk::PhysicalDeviceFeatures2{capabilities.features}, // Everything the device has
 		vk::PhysicalDeviceVulkan11Features{
 			false,
 			false,
@@ -349,6 +402,7 @@ void Renderer::create_logical_device() {
 			false,
 			true
 		},
+		vulkan_12_features,
 		vk::PhysicalDeviceVulkan13Features{
 			false,
 			false,
@@ -366,17 +420,22 @@ void Renderer::create_logical_device() {
 			false,
 			false
 			},      // Enable dynamic rendering from Vulkan 1.3
-		vk::PhysicalDeviceExtendedDynamicStateFeaturesEXT{ true }   // Enable extended dynamic state from the extension
+		vk::PhysicalDeviceExtendedDynamicStateFeaturesEXT{ true },   // Enable extended dynamic state from the extension
+		vk::PhysicalDeviceGraphicsPipelineLibraryFeaturesEXT{ true },
+		extended_dynamic_state_3_features
 	};
 
+	if (!pipeline_library_supported) featureChain.unlink<vk::PhysicalDeviceGraphicsPipelineLibraryFeaturesEXT>();
+	if (!dynamic_blend_supported) featureChain.unlink<vk::PhysicalDeviceExtendedDynamicState3FeaturesEXT>();
+
 	const vk::DeviceCreateInfo device_create_info{
 		{},
 		static_cast<uint32_t>(device_queue_create_infos.size()),
 		device_queue_create_infos.data(),
 		0,
 		nullptr,
-		static_cast<uint32_t>(device_extensions.size()),
-		device_extensions.data(),
+		static_cast<uint32_t>(extensions.size()),
+		extensions.data(),
 		nullptr,
 		featureChain.get<>()
 	};
@@ -465,6 +524,16 @@ void Renderer::create_swapchain() {
 	wnd::print(std::string("Color space: ") + to_string(surface_format.colorSpace));
 	wnd::print(std::string("Present mode: ") + to_string(present_mode));
 
+	// Transfer destination for the upscale of a lower render resolution
+	vk::ImageUsageFlags usage = vk::ImageUsageFlagBits::eColorAttachment;
+	swapchain_transfer_supported = static_cast<bool>(
+		details.capabilities.supportedUsageFlags & vk::ImageUsageFlagBits::eTransferDst);
+	if (swapchain_transfer_supported) usage |= vk::ImageUsageFlagBits::eTransferDst;
+	// Transfer source for the terminal output to read the frame back from
+	swapchain_readback_supported = static_cast<bool>(
+		details.capabilities.supportedUsageFlags & vk::ImageUsageFlagBits::eTransferSrc);
+	if (swapchain_readback_supported) usage |= vk::ImageUsageFlagBits::eTransferSrc;
+
 	vk::Extent2D swap_extent = choose_swap_extent(details.capabilities, window);
 	vk::SwapchainCreateInfoKHR swapchain_create_info = {
 		{},
@@ -474,7 +543,7 @@ void Renderer::create_swapchain() {
 		surface_format.colorSpace,
 		swap_extent,
 		1,
-		vk::ImageUsageFlagBits::eColorAttachment,
+		usage,
 		queue_family_count ? vk::SharingMode::eConcurrent : vk::SharingMode::eExclusive,
 		queue_family_count,
 		queue_family_count ? queue_family_indices : nullptr,
@@ -538,6 +607,47 @@ void Renderer::create_image_views() {
 
 
 
+void Renderer::choose_depth_format() {
+	wnd::begin_section("Depth buffer: ");
+
+	// Reversed-Z only pays off with a float format
+	constexpr vk::Format candidate = vk::Format::eD32Sfloat;
+	const vk::FormatProperties properties = physical_device.getFormatProperties(candidate);
+	if (!(properties.optimalTilingFeatures & vk::FormatFeatureFlagBits::eDepthStencilAttachment)) {
+		throw std::runtime_error("D32 float depth attachments are not supported");
+	}
+	depth_format = candidate;
+
+	wnd::print(std::string("Format: ") + to_string(depth_format));
+	wnd::print("Projection: reversed-Z, infinite far plane");
+	wnd::print();
+}
+
+
+
+void Renderer::choose_sample_count() {
+	wnd::begin_section("Multisampling: ");
+
+	const vk::PhysicalDeviceLimits &limits = capabilities.properties.limits;
+	supported_samples = limits.framebufferColorSampleCounts & limits.framebufferDepthSampleCounts;
+
+	// The highest supported count up to the requested one, e1 is always supported
+	msaa_samples = vk::SampleCountFlagBits::e1;
+	for (auto samples = static_cast<uint32_t>(MSAA_SAMPLES); samples > 1; samples >>= 1) {
+		if (supported_samples & static_cast<vk::SampleCountFlagBits>(samples)) {
+			msaa_samples = static_cast<vk::SampleCountFlagBits>(samples);
+			break;
+		}
+	}
+
+	wnd::print(std::string("Supported: ") + to_string(supported_samples));
+	wnd::print(std::string("Requested: ") + to_string(MSAA_SAMPLES));
+	wnd::print(std::string("Using:     ") + to_string(msaa_samples));
+	wnd::print();
+}
+
+
+
 std::vector<char> Renderer::readFile(const std::string& filename) {
 	std::ifstream file(filename, std::ios::ate | std::ios::binary);
 
@@ -557,172 +667,166 @@ std::vector<char> Renderer::readFile(const std::string& filename) {
 
 
 
-raii::ShaderModule Renderer::create_shader_module(std::vector<char> code) const {
-	const vk::ShaderModuleCreateInfo create_info = {
-		{},
-		code.size() * sizeof(char),
-		reinterpret_cast<const uint32_t *>(code.data())
-	};
+ShaderSource Renderer::load_shader(const std::string &filename) {
+	static uint64_t next_id = 0;
 
-	return raii::ShaderModule{device, create_info};
+	std::vector<char> code = readFile(filename);
+	spirv::Module reflected = spirv::reflect(code);
+	return {std::move(code), std::move(reflected), next_id++};
 }
 
 
 
 void Renderer::create_graphics_pipeline() {
 	wnd::begin_section("Graphics pipeline: ");
-	wnd::begin_frame("Shader.spv");
-	const std::vector<char> shader_code = readFile("shader.spv");
-	wnd::print(std::string("Buffer size: ") + std::to_string(shader_code.size()));
+	wnd::begin_frame(SHADER_FILE);
+	shader = std::make_shared<const ShaderSource>(shader_loading.get());
+	wnd::print(std::string("Buffer size: ") + std::to_string(shader->code.size()));
+	for (const spirv::EntryPoint &entry : shader->reflected.entry_points) {
+		wnd::print(
+			entry.name + " (" + to_string(entry.stage) + "): "
+			+ std::to_string(entry.bindings.size()) + " bindings, "
+			+ std::to_string(entry.vertex_inputs.size()) + " inputs, "
+			+ std::to_string(entry.push_constants.empty() ? 0 : entry.push_constants.front().size)
+			+ "B push constants");
+	}
+	for (const spirv::SpecializationConstant &constant : shader->reflected.specialization_constants) {
+		wnd::print(
+			"Constant " + std::to_string(constant.id) + ": "
+			+ std::to_string(constant.size) + "B, default " + std::to_string(constant.default_value));
+	}
 	wnd::end_frame();
 
-	raii::ShaderModule shader_module = create_shader_module(shader_code);
+	pipeline_factory.configure(format, depth_format, pipeline_library_supported, dynamic_blend_supported);
+	const std::vector<char> cache_data = pipeline_cache_loading.get();
+	const bool cache_used = pipeline_factory.create_cache(cache_data, capabilities.properties);
+	wnd::print(std::string("Pipeline cache: ") + (
+		cache_used ? std::to_string(cache_data.size() / 1024) + " KiB from " + PIPELINE_CACHE_FILE : "New"));
+	wnd::print(std::string("Pipeline libraries: ") + (pipeline_factory.uses_libraries() ? "Yes" : "No"));
+	wnd::print(std::string("Dynamic blending: ") + (pipeline_factory.has_dynamic_blend() ? "Yes" : "No"));
+
+	// Everything else compiles in the background and falls back to this one until ready
+	default_key.samples = msaa_samples;
+	default_pipeline = pipelines.compile_now("default", pipeline_builder(default_key));
+	pipelines.set_fallback(default_pipeline);
+
+	wnd::print(std::string("Compiler threads: ") + std::to_string(pipelines.thread_count()));
+	wnd::print(std::string("Pipeline layouts: ") + std::to_string(layout_cache.pipeline_layout_count()));
+	wnd::print(std::string("Set layouts: ") + std::to_string(layout_cache.set_layout_count()));
+	wnd::print();
+}
 
-	vk::PipelineShaderStageCreateInfo vertex_stage_create_info = {
-		{},
-		vk::ShaderStageFlagBits::eVertex,
-		shader_module,
-		"vertMain",
-		nullptr
-	};
 
-	vk::PipelineShaderStageCreateInfo fragment_stage_create_info = {
-		{},
-		vk::ShaderStageFlagBits::eFragment,
-		shader_module,
-		"fragMain",
-		nullptr
-	};
 
-	std::vector shader_stages = {vertex_stage_create_info, fragment_stage_create_info};
+// Drivers reuse what they compiled on the next start, a failure only costs that
+void Renderer::save_pipeline_cache() const {
+	try {
+		const std::vector<uint8_t> data = pipeline_factory.cache_data();
+		if (data.empty()) return;
+		std::ofstream file(PIPELINE_CACHE_FILE, std::ios::binary | std::ios::trunc);
+		if (!file.write(reinterpret_cast<const char *>(data.data()), static_cast<std::streamsize>(data.size()))) {
+			logging::warning("Failed to write {}", PIPELINE_CACHE_FILE);
+		}
+	} catch (const std::exception &e) {
+		logging::warning("Failed to save the pipeline cache: {}", e.what());
+	}
+}
+
 
-	std::vector dynamic_states = {
-		vk::DynamicState::eViewport,
-		vk::DynamicState::eScissor
-	};
 
-	vk::PipelineDynamicStateCreateInfo dynamic_state_create_info = {
-		{},
-		static_cast<uint32_t>(dynamic_states.size()),
-		dynamic_states.data()
+PipelineManager::Builder Renderer::pipeline_builder(const PipelineKey &key) {
+	return [this, source = shader, key] {
+		return pipeline_factory.build(*source, key.permutation, key.blend, key.samples);
 	};
+}
 
-	vk::PipelineVertexInputStateCreateInfo vertex_input_state_create_info = {};
 
-	vk::PipelineInputAssemblyStateCreateInfo input_assembly_create_info = {
-		{},
-		vk::PrimitiveTopology::eTriangleList,
-		false,
-	};
 
-	vk::PipelineViewportStateCreateInfo viewport_state = {
-		{},
-		1,
-		nullptr,
-		1,
-		nullptr,
-	};
+ShaderPermutation Renderer::current_permutation() const {
+	ShaderPermutation permutation;
+	if (grayscale) permutation.set(GRAYSCALE, true);
+	if (color_steps) permutation.set(COLOR_STEPS, color_steps);
+	return permutation;
+}
 
-	vk::PipelineRasterizationStateCreateInfo rasterization_state_create_info = {
-		{},
-		false,
-		false,
-		vk::PolygonMode::eFill,
-		vk::CullModeFlagBits::eBack,
-		vk::FrontFace::eClockwise,
-		false,
-		0.0f,
-		0.0f,
-		1.0f,
-		1.0f,
-	};
 
-	vk::PipelineMultisampleStateCreateInfo multisample_state_create_info = {
-		{},
-		vk::SampleCountFlagBits::e1,
-		false,
-		0.0f,
-		nullptr,
-		false,
-		false
-	};
 
-	vk::PipelineColorBlendAttachmentState blend_attachment_state = {
-		false,
-		vk::BlendFactor::eSrcAlpha,
-		vk::BlendFactor::eOneMinusSrcAlpha,
-		vk::BlendOp::eAdd,
-		vk::BlendFactor::eOne,
-		vk::BlendFactor::eZero,
-		vk::BlendOp::eAdd,
-		vk::ColorComponentFlagBits::eR |
-		vk::ColorComponentFlagBits::eG |
-		vk::ColorComponentFlagBits::eB |
-		vk::ColorComponentFlagBits::eA,
-	};
+const GraphicsPipeline &Renderer::pipeline_variant(const PipelineKey &key) {
+	if (key == default_key) return pipelines.get(default_pipeline);
 
-	std::vector blend_attachments = {
-		blend_attachment_state
-	};
+	auto variant = pipeline_variants.find(key);
+	if (variant == pipeline_variants.end()) {
+		const std::string name = key.permutation.to_string() + (key.blend ? " blend" : "")
+			+ " " + to_string(key.samples);
+		const PipelineManager::Handle handle = pipelines.request(name, pipeline_builder(key));
+		variant = pipeline_variants.emplace(key, handle).first;
+	}
 
-	vk::PipelineColorBlendStateCreateInfo blend_state_create_info = {
-		{},
-		false,
-		vk::LogicOp::eCopy,
-		static_cast<uint32_t>(blend_attachments.size()),
-		blend_attachments.data(),
-		{0.0, 0.0, 0.0, 0.0}
-	};
+	return pipelines.get(variant->second);
+}
 
-	vk::PipelineLayoutCreateInfo pipeline_layout_create_info = {
-		{},
-		0,
-		nullptr,
-		0,
-		nullptr
-	};
 
-	pipeline_layout = raii::PipelineLayout{
-		device,
-		pipeline_layout_create_info
-	};
 
-	vk::PipelineRenderingCreateInfo rendering_create_info = {
-		{},
-		1,
-		&format,
-		vk::Format::eUndefined,
-		vk::Format::eUndefined,
-	};
+void Renderer::reload_shaders() {
+	bool changed = false;
+	for (const std::string &file : shader_watcher.poll()) {
+		if (file == SHADER_FILE) changed = true;
+	}
 
-	vk::GraphicsPipelineCreateInfo pipeline_create_info = {
-		{},
-		static_cast<uint32_t>(shader_stages.size()),
-		shader_stages.data(),
-		&vertex_input_state_create_info,
-		&input_assembly_create_info,
-		nullptr,
-		&viewport_state,
-		&rasterization_state_create_info,
-		&multisample_state_create_info,
-		nullptr,
-		&blend_state_create_info,
-		&dynamic_state_create_info,
-		pipeline_layout,
-		nullptr,
-		0,
-		nullptr,
-		-1,
-		&rendering_create_info
-	};
+	if (changed) {
+		try {
+			shader = std::make_shared<const ShaderSource>(load_shader(SHADER_FILE));
+			pipeline_factory.evict_shader_libraries(shader->id);
+
+			// Only the pipelines built from this shader are recompiled; each keeps drawing its old
+			// version until the new one is collected
+			pipelines.rebuild(default_pipeline, pipeline_builder(default_key));
+			for (const auto &[key, handle] : pipeline_variants) {
+				pipelines.rebuild(handle, pipeline_builder(key));
+			}
+
+			logging::info("Reloading {}", SHADER_FILE);
+		} catch (const std::exception &e) {
+			logging::warning("Failed to reload {}, keeping the old pipelines: {}", SHADER_FILE, e.what());
+		}
+	}
 
-	graphics_pipeline = raii::Pipeline{
-		device,
-		nullptr,
-		pipeline_create_info
-	};
+	// draw_frame() waits for its fence, so between frames the GPU no longer references replaced pipelines
+	pipelines.collect();
+}
 
-	wnd::print();
+
+
+void Renderer::key_callback(GLFWwindow *window, const int key, int, const int action, int) {
+	if (action != GLFW_PRESS) return;
+	auto *renderer = static_cast<Renderer *>(glfwGetWindowUserPointer(window));
+
+	switch (key) {
+		case GLFW_KEY_G:
+			renderer->grayscale = !renderer->grayscale;
+			break;
+		case GLFW_KEY_P:
+			renderer->color_steps = renderer->color_steps >= 8 ? 0 : renderer->color_steps + 2;
+			break;
+		case GLFW_KEY_M: {
+			// Next supported sample count, back to e1 after the highest
+			auto samples = static_cast<uint32_t>(renderer->msaa_samples);
+			do {
+				samples = samples >= 64 ? 1 : samples << 1;
+			} while (!(renderer->supported_samples & static_cast<vk::SampleCountFlagBits>(samples)));
+			renderer->msaa_samples = static_cast<vk::SampleCountFlagBits>(samples);
+			break;
+		}
+		case GLFW_KEY_T:
+			if (trace::enabled()) {
+				save_trace();
+			} else {
+				trace::start();
+				logging::info("Tracing, T again writes {}", TRACE_FILE);
+			}
+			break;
+		default: break;
+	}
 }
 
 
@@ -758,104 +862,214 @@ void Renderer::create_command_buffer() {
 
 
 
-void Renderer::transition_image_layout(
-    uint32_t imageIndex,
-    vk::ImageLayout oldLayout,
-    vk::ImageLayout newLayout,
-    vk::AccessFlags2 srcAccessMask,
-    vk::AccessFlags2 dstAccessMask,
-    vk::PipelineStageFlags2 srcStageMask,
-    vk::PipelineStageFlags2 dstStageMask
-) {
-	vk::ImageMemoryBarrier2 barrier = {
-		srcStageMask,
-		srcAccessMask,
-		dstStageMask,
-		dstAccessMask,
-		oldLayout,
-		newLayout,
-		vk::QueueFamilyIgnored,
-		vk::QueueFamilyIgnored,
-		swapchain_images[imageIndex],
-		vk::ImageSubresourceRange{
-			vk::ImageAspectFlagBits::eColor,
-			0,
-			1,
-			0,
-			1
-		    }
-	};
-
-	vk::DependencyInfo dependencyInfo = {
-		{},
-		0,
-		nullptr,
-		0,
-		nullptr,
-		1,
-		&barrier
-	};
-
-	command_buffer.pipelineBarrier2(dependencyInfo);
-}
-
-
-
 void Renderer::record_command_buffer(const unsigned int& index) {
+	TRACE_ZONE("record_command_buffer");
 	command_buffer.begin({});
 
-	transition_image_layout(
-		index,
-		vk::ImageLayout::eUndefined,
-		vk::ImageLayout::eColorAttachmentOptimal,
-		vk::AccessFlagBits2::eNone,
-		vk::AccessFlagBits2::eColorAttachmentWrite,
-		vk::PipelineStageFlagBits2::eTopOfPipe,
-		vk::PipelineStageFlagBits2::eColorAttachmentOutput
-	);
+	if (*timestamp_queries) {
+		command_buffer.resetQueryPool(*timestamp_queries, 0, 2);
+		command_buffer.writeTimestamp2(vk::PipelineStageFlagBits2::eTopOfPipe, *timestamp_queries, 0);
+	}
+	gpu_trace->begin_frame(command_buffer);
+	gpu_trace->begin(command_buffer, "frame");
 
-	constexpr vk::ClearValue clear_color = vk::ClearColorValue(0.2f, 0.4f, 0.8f, 1.0f);
+	RenderGraph graph{transient_allocator};
 
-	vk::RenderingAttachmentInfo attachment_info = {
+	// Cleared on load, so the previous contents are discarded. The image is only ready once the acquire
+	// semaphore's wait stage is reached.
+	const RenderGraph::Resource backbuffer = graph.import_image(
+		"swapchain",
+		swapchain_images[index],
 		image_views[index],
-		vk::ImageLayout::eColorAttachmentOptimal,
-		vk::ResolveModeFlagBits::eNone,
-		nullptr,
+		vk::ImageAspectFlagBits::eColor,
 		vk::ImageLayout::eUndefined,
-		vk::AttachmentLoadOp::eClear,
-		vk::AttachmentStoreOp::eStore,
-		clear_color
+		vk::PipelineStageFlagBits2::eColorAttachmentOutput
+	);
+
+	// Attachments follow the pipeline actually drawn with, which is the default one until a variant for a
+	// new sample count is compiled
+	const PipelineKey pipeline_key = {
+		current_permutation(),
+		pipeline_factory.baked_blend(draw_state),
+		msaa_samples
 	};
+	const GraphicsPipeline &pipeline = pipeline_variant(pipeline_key);
+	const vk::SampleCountFlagBits samples = pipeline.samples;
+
+	const RenderGraph::Resource depth = graph.create_image("depth", {
+		depth_format,
+		extent,
+		vk::ImageAspectFlagBits::eDepth,
+		samples
+	});
+
+	// With dynamic resolution the scene goes to the top left of a full size target and is scaled up from there,
+	// so a new resolution never reallocates anything
+	const vk::Extent2D render_extent = dynamic_resolution_supported ? resolution.render_extent(extent) : extent;
+	RenderGraph::Resource target = backbuffer;
+	if (dynamic_resolution_supported) {
+		target = graph.create_image("scene", {
+			format,
+			extent,
+			vk::ImageAspectFlagBits::eColor
+		});
+	}
 
-	vk::RenderingInfo rendering_info = {
-		{},
-		{{0, 0}, extent},
-		1,
-		0,
-		1,
-		&attachment_info,
-		nullptr,
-		nullptr
+	// Multisampled color is resolved at the end of the pass and never stored, so on tilers it stays on chip
+	RenderGraph::Resource multisampled = target;
+	if (samples != vk::SampleCountFlagBits::e1) {
+		multisampled = graph.create_image("multisampled", {
+			format,
+			extent,
+			vk::ImageAspectFlagBits::eColor,
+			samples
+		});
+	}
+
+	camera.aspect = static_cast<float>(extent.width) / static_cast<float>(extent.height);
+	const InstanceBuffer::Addresses instance_addresses = instances->addresses();
+	const PushConstants push_constants = {
+		camera.view_projection(),
+		instance_addresses.rotations,
+		instance_addresses.positions
 	};
 
-	command_buffer.beginRendering(rendering_info);
-	command_buffer.bindPipeline(vk::PipelineBindPoint::eGraphics, graphics_pipeline);
-	command_buffer.setViewport(0, vk::Viewport(
-		0.0f, 0.0f,
-		static_cast<float>(extent.width), static_cast<float>(extent.height),
-		0.0f,1.0f));
-	command_buffer.setScissor(0, vk::Rect2D(vk::Offset2D(0, 0), extent));
-	command_buffer.draw(3, 1, 0, 0);
-	command_buffer.endRendering();
-	transition_image_layout(
-		index,
-		vk::ImageLayout::eColorAttachmentOptimal,
-		vk::ImageLayout::ePresentSrcKHR,
-		vk::AccessFlagBits2::eColorAttachmentWrite,
-		vk::AccessFlagBits2::eNone,
-		vk::PipelineStageFlagBits2::eColorAttachmentOutput,
-		vk::PipelineStageFlagBits2::eBottomOfPipe
-		);
+	const InstanceBuffer::Batch scene_instances = upload_instances();
+
+	// Opaque geometry goes first, front to back, with depth writes on so early tests reject hidden fragments.
+	// Blended geometry belongs in a later pass that only tests against the finished depth buffer.
+	RenderGraph::Pass &opaque = graph.add_pass("opaque");
+	opaque.write(target, RenderGraph::Usage::ColorAttachment);
+	if (multisampled != target) opaque.write(multisampled, RenderGraph::Usage::ColorAttachment);
+	opaque.write(depth, RenderGraph::Usage::DepthAttachment)
+		.execute([&](const raii::CommandBuffer &cmd) {
+			constexpr vk::ClearValue clear_color = vk::ClearColorValue(0.2f, 0.4f, 0.8f, 1.0f);
+			constexpr vk::ClearValue clear_depth = vk::ClearDepthStencilValue(Camera::CLEAR_DEPTH, 0);
+
+			vk::RenderingAttachmentInfo attachment_info = {
+				graph.view(target),
+				vk::ImageLayout::eColorAttachmentOptimal,
+				vk::ResolveModeFlagBits::eNone,
+				nullptr,
+				vk::ImageLayout::eUndefined,
+				vk::AttachmentLoadOp::eClear,
+				vk::AttachmentStoreOp::eStore,
+				clear_color
+			};
+			if (multisampled != target) {
+				attachment_info.imageView = graph.view(multisampled);
+				attachment_info.resolveMode = vk::ResolveModeFlagBits::eAverage;
+				attachment_info.resolveImageView = graph.view(target);
+				attachment_info.resolveImageLayout = vk::ImageLayout::eColorAttachmentOptimal;
+				attachment_info.storeOp = vk::AttachmentStoreOp::eDontCare;
+			}
+
+			// Only tested within the pass, never stored
+			vk::RenderingAttachmentInfo depth_attachment_info = {
+				graph.view(depth),
+				vk::ImageLayout::eDepthAttachmentOptimal,
+				vk::ResolveModeFlagBits::eNone,
+				nullptr,
+				vk::ImageLayout::eUndefined,
+				vk::AttachmentLoadOp::eClear,
+				vk::AttachmentStoreOp::eDontCare,
+				clear_depth
+			};
+
+			vk::RenderingInfo rendering_info = {
+				{},
+				{{0, 0}, render_extent},
+				1,
+				0,
+				1,
+				&attachment_info,
+				&depth_attachment_info,
+				nullptr
+			};
+
+			cmd.beginRendering(rendering_info);
+			cmd.bindPipeline(vk::PipelineBindPoint::eGraphics, pipeline.pipeline);
+			pipeline_factory.set_draw_state(cmd, draw_state);
+			// Range and stages come from the shader's reflection, a reloaded shader may not declare it
+			if (pipeline.push_constants.size >= sizeof(PushConstants)) {
+				cmd.pushConstants<PushConstants>(
+					pipeline.layout,
+					pipeline.push_constants.stageFlags,
+					pipeline.push_constants.offset,
+					push_constants);
+			}
+			cmd.setViewport(0, vk::Viewport(
+				0.0f, 0.0f,
+				static_cast<float>(render_extent.width), static_cast<float>(render_extent.height),
+				0.0f,1.0f));
+			cmd.setScissor(0, vk::Rect2D(vk::Offset2D(0, 0), render_extent));
+			// One instanced draw per mesh, the built-in triangle is the only one so far
+			cmd.draw(3, scene_instances.count, 0, scene_instances.first);
+			cmd.endRendering();
+		});
+
+	if (target != backbuffer) {
+		graph.add_pass("upscale")
+			.read(target, RenderGraph::Usage::TransferSource)
+			.write(backbuffer, RenderGraph::Usage::TransferDestination)
+			.execute([&](const raii::CommandBuffer &cmd) {
+				const auto corner = [](const vk::Extent2D size) {
+					return vk::Offset3D{static_cast<int32_t>(size.width), static_cast<int32_t>(size.height), 1};
+				};
+				const vk::ImageSubresourceLayers color = {vk::ImageAspectFlagBits::eColor, 0, 0, 1};
+
+				const vk::ImageBlit2 region = {
+					color,
+					{vk::Offset3D{0, 0, 0}, corner(render_extent)},
+					color,
+					{vk::Offset3D{0, 0, 0}, corner(extent)}
+				};
+				const vk::BlitImageInfo2 blit_info = {
+					graph.image(target),
+					vk::ImageLayout::eTransferSrcOptimal,
+					graph.image(backbuffer),
+					vk::ImageLayout::eTransferDstOptimal,
+					1,
+					&region,
+					vk::Filter::eLinear
+				};
+				cmd.blitImage2(blit_info);
+			});
+	}
+
+	if (terminal) terminal->add_passes(graph, target, render_extent, frame_number);
+
+	graph.present(backbuffer);
+	graph.compile();
+	RenderGraph::Marker marker;
+	if (gpu_trace->recording_frame()) {
+		marker = [this](const raii::CommandBuffer &commands, const std::string &pass, const bool end) {
+			if (end) {
+				gpu_trace->end(commands);
+			} else {
+				gpu_trace->begin(commands, pass);
+			}
+		};
+	}
+	graph.execute(command_buffer, marker);
+
+	if (*timestamp_queries) {
+		command_buffer.writeTimestamp2(vk::PipelineStageFlagBits2::eBottomOfPipe, *timestamp_queries, 1);
+		timestamps_pending = true;
+	}
+	gpu_trace->end(command_buffer);
+
+	if (transient_allocator.generation() != reported_transient_generation) {
+		reported_transient_generation = transient_allocator.generation();
+		const TransientAllocator::Report &report = transient_allocator.report();
+		logging::info(
+			"Transient images: {} in {} blocks, {} KiB ({} KiB lazy), {} KiB saved by aliasing",
+			report.image_count,
+			report.block_count,
+			report.allocated_bytes / 1024,
+			report.lazy_bytes / 1024,
+			(report.unaliased_bytes - report.allocated_bytes) / 1024);
+	}
 
 	command_buffer.end();
 }
@@ -870,30 +1084,277 @@ void Renderer::create_sync_objects() {
 
 
 
-Renderer::Renderer() {
+void Renderer::create_timestamp_queries() {
+	wnd::begin_section("Dynamic resolution: ");
+
+	const uint32_t valid_bits = capabilities.queue_families[graphics_queue_index].timestampValidBits;
+	// The scene image is blitted into a swapchain image of the same format
+	const vk::FormatFeatureFlags blit_features =
+		vk::FormatFeatureFlagBits::eBlitSrc |
+		vk::FormatFeatureFlagBits::eBlitDst |
+		vk::FormatFeatureFlagBits::eSampledImageFilterLinear;
+	const bool blit_supported =
+		(physical_device.getFormatProperties(format).optimalTilingFeatures & blit_features) == blit_features;
+
+	wnd::print(std::string("Timestamps:     ") + (valid_bits ? std::to_string(valid_bits) + " bits" : "No"));
+	wnd::print(std::string("Swapchain blit: ") + (swapchain_transfer_supported && blit_supported ? "Yes" : "No"));
+
+	if (valid_bits) {
+		timestamp_queries = raii::QueryPool{device, vk::QueryPoolCreateInfo{{}, vk::QueryType::eTimestamp, 2}};
+		timestamp_period = capabilities.properties.limits.timestampPeriod;
+		timestamp_mask = valid_bits >= 64 ? ~0ull : (1ull << valid_bits) - 1;
+	}
+	dynamic_resolution_supported = valid_bits && swapchain_transfer_supported && blit_supported;
+
+	// Budget one refresh interval of the primary monitor, minus some slack for presentation
+	if (GLFWmonitor *monitor = glfwGetPrimaryMonitor()) {
+		if (const GLFWvidmode *mode = glfwGetVideoMode(monitor); mode && mode->refreshRate > 0) {
+			resolution.set_target(900.0f / static_cast<float>(mode->refreshRate));
+		}
+	}
+
+	wnd::print(std::string("Enabled:        ") + (dynamic_resolution_supported ? "Yes" : "No"));
+	wnd::print(std::string("GPU budget:     ") + std::to_string(resolution.target()) + "ms");
+
+	gpu_trace.emplace(device, capabilities, graphics_queue_index, calibrated_timestamps_supported);
+	wnd::print(std::string("GPU trace:      ") + (
+		!gpu_trace->supported() ? "No" : gpu_trace->timestamps_calibrated() ? "Calibrated" : "Aligned to fence"));
+	wnd::print();
+}
+
+
+
+void Renderer::read_gpu_time() {
+	if (!timestamps_pending) return;
+	timestamps_pending = false;
+
+	// The frame's fence has been waited on, so both results are there
+	const auto [result, timestamps] = timestamp_queries.getResults<uint64_t>(
+		0,
+		2,
+		2 * sizeof(uint64_t),
+		sizeof(uint64_t),
+		vk::QueryResultFlagBits::e64);
+	if (result != vk::Result::eSuccess) return;
+
+	const uint64_t ticks = (timestamps[1] - timestamps[0]) & timestamp_mask;
+	const float gpu_ms = static_cast<float>(static_cast<double>(ticks) * timestamp_period / 1'000'000.0);
+	if (dynamic_resolution_supported) resolution.update(gpu_ms);
+}
+
+
+
+void Renderer::create_instance_buffer() {
+	wnd::begin_section("Instances: ");
+
+	instances.emplace(device, capabilities.memory, 1, MAX_INSTANCES);
+
+	wnd::print(std::string("Capacity:     ") + std::to_string(instances->max_instances()));
+	wnd::print(std::string("Buffer size:  ") + std::to_string(MAX_INSTANCES * 2 * sizeof(glm::vec4) / 1024) + " KiB");
+	wnd::print(std::string("Device local: ") + (instances->device_local() ? "Yes" : "No"));
+	wnd::print();
+}
+
+
+
+void Renderer::create_scene() {
+	wnd::begin_section("Scene: ");
+
+	constexpr float grid_offset = (INSTANCE_GRID - 1) * INSTANCE_SPACING * 0.5f;
+	for (uint32_t y = 0; y < INSTANCE_GRID; ++y) {
+		for (uint32_t x = 0; x < INSTANCE_GRID; ++x) {
+			const Transform transform = {
+				.position = {
+					static_cast<float>(x) * INSTANCE_SPACING - grid_offset,
+					static_cast<float>(y) * INSTANCE_SPACING - grid_offset,
+					0.0f
+				}
+			};
+
+			// Every fourth one stands still, those are never uploaded again
+			const auto i = static_cast<float>(y * INSTANCE_GRID + x);
+			if ((x + y) % 4 == 0) {
+				scene.create(transform);
+			} else {
+				scene.create(transform, Spin{
+					glm::normalize(glm::vec3{std::sin(i * 0.37f), std::cos(i * 0.53f), 1.0f}),
+					0.5f + static_cast<float>((x * 7 + y) % 8) * 0.25f
+				});
+			}
+		}
+	}
+
+	wnd::print(std::string("Entities:    ") + std::to_string(scene.entity_count()));
+	wnd::print(std::string("Archetypes:  ") + std::to_string(scene.archetype_count()));
+	wnd::print(std::string("Job threads: ") + std::to_string(jobs.thread_count()) + " + main");
+	wnd::print();
+}
+
+
+
+void Renderer::create_terminal_output() {
+	wnd::begin_section("Terminal output: ");
+
+	// Reads from the scene image with dynamic resolution, otherwise straight from the swapchain
+	const bool blit_supported = static_cast<bool>(
+		physical_device.getFormatProperties(format).optimalTilingFeatures & vk::FormatFeatureFlagBits::eBlitSrc);
+	if (!blit_supported || !(dynamic_resolution_supported || swapchain_readback_supported)) {
+		throw std::runtime_error("The terminal output needs blits from " + to_string(format) + " images");
+	}
+
+	terminal.emplace(device, physical_device, capabilities.memory, format, extent, TerminalOutput::detect_mode());
+
+	const vk::Extent2D cells = terminal->cells();
+	wnd::print(std::string("Cells:       ") + std::to_string(cells.width) + " x " + std::to_string(cells.height));
+	wnd::print(std::string("Mode:        ") + (terminal->current_mode() == TerminalOutput::Mode::HalfBlock ? "Half blocks, truecolor" : "ASCII"));
+	wnd::print(std::string("Readback:    ") + std::to_string(terminal->buffer_size() / 1024) + " KiB x 3");
+	wnd::print(std::string("Coherent:    ") + (terminal->host_coherent() ? "Yes" : "No"));
+	wnd::print();
+}
+
+
+
+void Renderer::update_scene(const float seconds) {
+	scene.parallel_each<Transform, const Spin>([seconds](Entity, Transform &transform, const Spin &spin) {
+		transform.rotation = glm::normalize(glm::angleAxis(spin.speed * seconds, spin.axis) * transform.rotation);
+	});
+}
+
+
+
+InstanceBuffer::Batch Renderer::upload_instances() {
+	// draw_frame() waits for the previous frame, so there is a single buffer, still holding the last upload
+	instances->begin_frame(0);
+	const InstanceBuffer::Batch batch = instances->allocate(static_cast<uint32_t>(scene.count<Transform>()));
+
+	// Created, destroyed or restructured entities move rows around, then every instance is written again
+	const bool everything = instances_synced_structure != scene.structure_version();
+	instances_uploaded = 0;
+	uint32_t first = 0;
+	scene.chunks<Transform>([&](const std::span<const Transform> transforms, const std::span<const uint32_t> changed) {
+		for (uint32_t i = 0; i < transforms.size(); ++i) {
+			if (!everything && changed[i] <= instances_synced_tick) continue;
+			batch.set(first + i, transforms[i].rotation, transforms[i].position, transforms[i].scale);
+			++instances_uploaded;
+		}
+		first += static_cast<uint32_t>(transforms.size());
+	});
+
+	instances_synced_tick = scene.tick();
+	instances_synced_structure = scene.structure_version();
+	scene.advance_tick();
+	return batch;
+}
+
+
+
+void Renderer::phase(const char *name, const std::function<void()> &step) {
+	const trace::Zone zone{name};
+	const auto begin = ch::steady_clock::now();
+	step();
+	startup_phases.emplace_back(name, ch::duration<float, std::milli>(ch::steady_clock::now() - begin).count());
+}
+
+
+
+void Renderer::print_startup_times() const {
+	wnd::begin_section("Startup: ");
+
+	float total = 0.0f;
+	for (const auto &[name, milliseconds] : startup_phases) {
+		wnd::print(wnd::set_length(name, 17) + std::to_string(milliseconds) + "ms");
+		total += milliseconds;
+	}
+	wnd::print(wnd::set_length("Total", 17) + std::to_string(total) + "ms");
+
+	wnd::begin_frame("In the background:");
+	wnd::print(wnd::set_length("Shader", 15) + std::to_string(shader_load_ms) + "ms");
+	wnd::print(wnd::set_length("Pipeline cache", 15) + std::to_string(pipeline_cache_load_ms) + "ms");
+	wnd::print(wnd::set_length("Device ranking", 15) + std::to_string(device_ranking_ms) + "ms");
+	wnd::end_frame();
+	wnd::print();
+}
+
+
+
+Renderer::Renderer(const bool terminal_output) {
 	std::cout << "\n\n\n";
 
-	create_window();
-	context = {}; // Setup context :)
-	create_vulkan_instance();
-	create_display_surface();
-	choose_physical_device();
-	get_queue_indices();
-	create_logical_device();
-	create_swapchain();
-	create_image_views();
-
-	create_graphics_pipeline();
-	create_command_pool();
-	create_command_buffer();
-	create_sync_objects();
+	// Files are read while GLFW and Vulkan start up
+	shader_loading = std::async(std::launch::async, [this] {
+		TRACE_ZONE("load_shader");
+		const auto begin = ch::steady_clock::now();
+		ShaderSource source = load_shader(SHADER_FILE);
+		shader_load_ms = ch::duration<float, std::milli>(ch::steady_clock::now() - begin).count();
+		return source;
+	});
+	pipeline_cache_loading = std::async(std::launch::async, [this] {
+		TRACE_ZONE("load pipeline cache");
+		const auto begin = ch::steady_clock::now();
+		std::vector<char> data; // Stays empty on the first start
+		if (std::ifstream file(PIPELINE_CACHE_FILE, std::ios::binary | std::ios::ate); file) {
+			data.resize(static_cast<size_t>(file.tellg()));
+			file.seekg(0);
+			if (!file.read(data.data(), static_cast<std::streamsize>(data.size()))) data.clear();
+		}
+		pipeline_cache_load_ms = ch::duration<float, std::milli>(ch::steady_clock::now() - begin).count();
+		return data;
+	});
 
+	wnd::begin("LavaChicken debug console", wnd::all_buttons, 64);
+	phase("GLFW", [] {
+		if (!glfwInit()) throw std::runtime_error("failed to initialize GLFW!");
+	});
+	phase("Vulkan instance", [this] {
+		context = {}; // Setup context :)
+		create_vulkan_instance();
+	});
+	// The devices are ranked while the window opens, only the surface checks wait for it
+	device_candidates = std::async(std::launch::async, [this] {
+		TRACE_ZONE("rank_devices");
+		const auto begin = ch::steady_clock::now();
+		std::vector<DeviceCandidate> candidates = rank_devices();
+		device_ranking_ms = ch::duration<float, std::milli>(ch::steady_clock::now() - begin).count();
+		return candidates;
+	});
+	phase("Window", [this] {
+		create_window();
+		create_display_surface();
+	});
+	phase("Device", [this] {
+		choose_physical_device();
+		get_queue_indices();
+		create_logical_device();
+	});
+	phase("Swapchain", [this] {
+		create_swapchain();
+		create_image_views();
+		choose_depth_format();
+		choose_sample_count();
+	});
+	phase("Pipelines", [this] { create_graphics_pipeline(); });
+	phase("Frame resources", [this] {
+		create_command_pool();
+		create_command_buffer();
+		create_sync_objects();
+		create_timestamp_queries();
+		create_instance_buffer();
+	});
+	phase("Scene", [this, terminal_output] {
+		create_scene();
+		if (terminal_output) create_terminal_output();
+	});
+	print_startup_times();
+
+	wnd::flush();
 	std::cout << "\n\n\n";
 }
 
 
 
 Renderer::~Renderer() {
+	if (trace::enabled()) save_trace();
+	save_pipeline_cache();
 	swapchain.clear();
 	glfwDestroyWindow(window);
 	glfwTerminate();
@@ -901,11 +1362,28 @@ Renderer::~Renderer() {
 
 
 
+// Stops tracing and writes what was recorded, called from the key callback and the destructor so it does not throw
+void Renderer::save_trace() {
+	trace::stop();
+	try {
+		const size_t zones = trace::write(TRACE_FILE);
+		logging::info("Wrote {} zones to {}", zones, TRACE_FILE);
+	} catch (const std::exception &e) {
+		logging::error("{}", e.what());
+	}
+}
+
+
+
 void Renderer::draw_frame() {
-	auto [result, imageIndex] = swapchain.acquireNextImage(
-		UINT64_MAX,
-		*present_complete_semaphore,
-		nullptr);
+	TRACE_ZONE("draw_frame");
+	auto [result, imageIndex] = [this] {
+		TRACE_ZONE("acquireNextImage");
+		return swapchain.acquireNextImage(
+			UINT64_MAX,
+			*present_complete_semaphore,
+			nullptr);
+	}();
 
 	record_command_buffer(imageIndex);
 	device.resetFences(*draw_fence);
@@ -921,9 +1399,19 @@ void Renderer::draw_frame() {
 		*render_finished_semaphore
 	};
 
-	graphics_queue.submit(submit_info, draw_fence);
+	{
+		TRACE_ZONE("submit");
+		graphics_queue.submit(submit_info, draw_fence);
+	}
 
-	while (device.waitForFences(*draw_fence, true, UINT64_MAX) == vk::Result::eTimeout) {}
+	{
+		TRACE_ZONE("waitForFences");
+		while (device.waitForFences(*draw_fence, true, UINT64_MAX) == vk::Result::eTimeout) {}
+	}
+	if (gpu_trace->recording_frame()) gpu_trace->collect(trace::now());
+	read_gpu_time();
+	if (terminal) terminal->collect(frame_number);
+	frame_number++;
 
 	const vk::PresentInfoKHR presentInfoKHR = {
 		*render_finished_semaphore,
@@ -931,7 +1419,10 @@ void Renderer::draw_frame() {
 		imageIndex
 	};
 
-	result = present_queue.presentKHR(presentInfoKHR);
+	{
+		TRACE_ZONE("presentKHR");
+		result = present_queue.presentKHR(presentInfoKHR);
+	}
 
 	//glfwSwapBuffers(window);
 }
@@ -944,11 +1435,29 @@ void Renderer::main_loop() {
 	unsigned long long frame_time = 0;
 	constexpr unsigned short max_i = 1'000;
 
+	auto last_begin = ch::high_resolution_clock::now();
 	while (!glfwWindowShouldClose(window)) {
 		auto begin = ch::high_resolution_clock::now();
 
-		glfwPollEvents();
+		{
+			TRACE_ZONE("glfwPollEvents");
+			glfwPollEvents();
+		}
+		{
+			TRACE_ZONE("reload_shaders");
+			reload_shaders();
+		}
+		{
+			TRACE_ZONE("update_scene");
+			update_scene(ch::duration<float>(begin - last_begin).count());
+		}
+		last_begin = begin;
 		draw_frame();
+		if (frame_number == 1) {
+			logging::info(
+				"First frame {} ms after the renderer started",
+				ch::duration<float, std::milli>(ch::steady_clock::now() - startup_begin).count());
+		}
 
 		auto end = ch::high_resolution_clock::now();
 
@@ -956,10 +1465,25 @@ void Renderer::main_loop() {
 
 		if (i++ >= max_i) {
 			const unsigned long long arg_frame_time = frame_time / max_i;
-			std::cout << "Time : ";
-			std::cout << arg_frame_time * 0.00'1;
-			std::cout << "\tms\t; FPS: ";
-			std::cout << 1'000'000.0 / arg_frame_time << "\n";
+			const double milliseconds = arg_frame_time * 0.00'1;
+			const double fps = 1'000'000.0 / arg_frame_time;
+			// Logging to the console would scroll the picture away, the terminal output shows it below instead
+			if (terminal) {
+				std::ostringstream line;
+				line << "Time: " << milliseconds << " ms; FPS: " << fps;
+				line << "; GPU: " << resolution.gpu_time() << " ms; Scale: " << resolution.current_scale();
+				line << "; Uploaded: " << instances_uploaded << "/" << scene.count<Transform>();
+				terminal->set_status(line.str());
+			} else {
+				logging::info(
+					"Time: {} ms; FPS: {}; GPU: {} ms; Scale: {}; Uploaded: {}/{}",
+					milliseconds,
+					fps,
+					resolution.gpu_time(),
+					resolution.current_scale(),
+					instances_uploaded,
+					scene.count<Transform>());
+			}
 			frame_time = 0;
 			i = 0;
 		}
@@ -1,5 +1,11 @@
 #pragma once
 
+#include <chrono>
+#include <functional>
+#include <future>
+#include <memory>
+#include <optional>
+#include <unordered_map>
 #include <vector>
 #include <string>
 
@@ -9,11 +15,30 @@
 
 #include <vulkan/vulkan_raii.hpp>
 
+#include "Camera.h"
+#include "DeviceCapabilities.h"
+#include "DynamicResolution.h"
+#include "EntityWorld.h"
+#include "GpuTrace.h"
+#include "InstanceBuffer.h"
+#include "JobSystem.h"
+#include "PipelineFactory.h"
+#include "PipelineLayoutCache.h"
+#include "PipelineManager.h"
+#include "RenderGraph.h"
+#include "SceneComponents.h"
+#include "ShaderPermutation.h"
+#include "ShaderWatcher.h"
+#include "TransientAllocator.h"
+#include "SpirvReflection.h"
+#include "TerminalOutput.h"
+
 namespace raii = vk::raii;
 
 class Renderer {
 public:
-	Renderer();
+	// terminal_output: also draws the frames into the terminal, see TerminalOutput
+	explicit Renderer(bool terminal_output = false);
 	void main_loop();
 	~Renderer();
 
@@ -23,6 +48,7 @@ private:
 	raii::Instance instance{nullptr};
 	raii::SurfaceKHR display_surface{nullptr};
 	raii::PhysicalDevice physical_device{nullptr};
+	DeviceCapabilities capabilities; // Of physical_device, what later steps ask about it comes from here
 	unsigned int graphics_queue_index{};
 	unsigned int compute_queue_index{};
 	unsigned int decode_queue_index{};
@@ -35,15 +61,102 @@ private:
 	raii::SwapchainKHR swapchain{nullptr};
 	std::vector<vk::Image> swapchain_images;
 	vk::Format format = {};
+	vk::Format depth_format = {};
+	vk::SampleCountFlags supported_samples = vk::SampleCountFlagBits::e1; // For color and depth attachments
+	vk::SampleCountFlagBits msaa_samples = vk::SampleCountFlagBits::e1;
 	vk::Extent2D extent{};
 	std::vector<raii::ImageView> image_views;
-	raii::PipelineLayout pipeline_layout{nullptr};
-	raii::Pipeline graphics_pipeline{nullptr};
+
+	// Everything a draw needs compiled into its pipeline, the rest of DrawState is dynamic
+	struct PipelineKey {
+		ShaderPermutation permutation;
+		bool blend = false;
+		vk::SampleCountFlagBits samples = vk::SampleCountFlagBits::e1;
+
+		bool operator==(const PipelineKey &) const = default;
+
+		struct Hash {
+			size_t operator()(const PipelineKey &key) const {
+				return (key.permutation.hash() * 2 + key.blend) * 131 + static_cast<size_t>(key.samples);
+			}
+		};
+	};
+
+	using PipelineVariants = std::unordered_map<PipelineKey, PipelineManager::Handle, PipelineKey::Hash>;
+
+	bool pipeline_library_supported = false;
+
+	PipelineLayoutCache layout_cache{device};
+	PipelineFactory pipeline_factory{device, layout_cache};
+	std::shared_ptr<const ShaderSource> shader; // Shared with the builders of queued compiles
+	PipelineManager pipelines;
+	PipelineKey default_key;                    // No permutation, startup sample count
+	PipelineManager::Handle default_pipeline{}; // Default key, also the fallback for everything else
+	PipelineVariants pipeline_variants;
+	// Reversed-Z: nearer fragments have greater depth
+	DrawState draw_state{
+		.depth_test = true,
+		.depth_write = true,
+		.depth_compare = vk::CompareOp::eGreaterOrEqual
+	};
+	bool dynamic_blend_supported = false;
+	ShaderWatcher shader_watcher{"."};
+
+	// Specialization constant ids declared in shader.slang
+	enum ShaderConstant : uint32_t {
+		GRAYSCALE = 0,
+		COLOR_STEPS = 1,
+	};
+
+	// Mirrors PushConstants in shader.slang
+	struct PushConstants {
+		glm::mat4 view_projection;
+		vk::DeviceAddress rotations;
+		vk::DeviceAddress positions;
+	};
+
+	Camera camera{.position = {0.0f, 0.0f, INSTANCE_GRID * INSTANCE_SPACING}};
+	std::optional<InstanceBuffer> instances;
+
+	JobSystem jobs;
+	EntityWorld scene{jobs};
+	// What the instance buffer holds, only rows the scene changed after instances_synced_tick are uploaded again
+	uint32_t instances_synced_tick = 0;
+	uint64_t instances_synced_structure = UINT64_MAX;
+	uint32_t instances_uploaded = 0;
+
+	std::optional<TerminalOutput> terminal;
+	uint64_t frame_number = 0; // Submissions so far, tells the terminal output which readbacks are done
+
+	bool grayscale = false;
+	int color_steps = 0;
+
+	TransientAllocator transient_allocator{device, capabilities.memory};
+	size_t reported_transient_generation = 0;
+
 	raii::CommandPool command_pool{nullptr};
 	raii::CommandBuffer command_buffer{nullptr};
 
-	[[nodiscard]] bool has_extensions(const raii::PhysicalDevice &device) const;
-	[[nodiscard]] short rank_score(const raii::PhysicalDevice &device) const;
+	// Startup runs in timed phases on this thread, work that does not depend on them runs next to them
+	struct DeviceCandidate {
+		raii::PhysicalDevice device;
+		DeviceCapabilities capabilities;
+		short score; // INT16_MIN if unsuitable, not counting the surface
+	};
+
+	std::chrono::steady_clock::time_point startup_begin = std::chrono::steady_clock::now();
+	std::vector<std::pair<const char *, float>> startup_phases; // Milliseconds
+	float shader_load_ms = 0.0f; // Written by the tasks before their result is ready
+	float pipeline_cache_load_ms = 0.0f;
+	float device_ranking_ms = 0.0f;
+	size_t cached_capabilities = 0; // Candidates whose capabilities came from DEVICE_CACHE_FILE
+
+	void phase(const char *name, const std::function<void()> &step);
+	void print_startup_times() const;
+
+	[[nodiscard]] bool has_extensions(const DeviceCapabilities &device) const;
+	[[nodiscard]] short rank_score(const DeviceCapabilities &device) const;
+	[[nodiscard]] std::vector<DeviceCandidate> rank_devices();
 	void choose_physical_device();
 	void create_display_surface();
 	void create_vulkan_instance();
@@ -52,20 +165,29 @@ private:
 	void create_logical_device();
 	void create_swapchain();
 	void create_image_views();
+	void choose_depth_format();
+	void choose_sample_count();
 
 	[[nodiscard]] static std::vector<char> readFile(const std::string &filename);
-	[[nodiscard]] raii::ShaderModule create_shader_module(std::vector<char> code) const;
+
+	[[nodiscard]] static ShaderSource load_shader(const std::string &filename);
 
 	void create_graphics_pipeline();
+	void save_pipeline_cache() const;
+	[[nodiscard]] PipelineManager::Builder pipeline_builder(const PipelineKey &key);
+	[[nodiscard]] ShaderPermutation current_permutation() const;
+	[[nodiscard]] const GraphicsPipeline &pipeline_variant(const PipelineKey &key);
+	void reload_shaders();
+	static void key_callback(GLFWwindow *window, int key, int scancode, int action, int mods);
 	void create_command_pool();
 	void create_command_buffer();
-	void transition_image_layout(
-		uint32_t imageIndex,
-		vk::ImageLayout		oldLayout,	vk::ImageLayout		newLayout,
-		vk::AccessFlags2	srcAccessMask,	vk::AccessFlags2	dstAccessMask,
-		vk::PipelineStageFlags2	srcStageMask,	vk::PipelineStageFlags2	dstStageMask);
 	void record_command_buffer(const unsigned int &index);
 	void create_sync_objects();
+	void create_instance_buffer();
+	void create_scene();
+	void create_terminal_output();
+	void update_scene(float seconds);
+	[[nodiscard]] InstanceBuffer::Batch upload_instances();
 
 	static vk::SurfaceFormatKHR choose_swap_surface_format(const std::vector<vk::SurfaceFormatKHR> &availableFormats);
 	static vk::PresentModeKHR choose_swap_present_mode(const std::vector<vk::PresentModeKHR> &availablePresentModes);
@@ -85,7 +207,24 @@ private:
 	raii::Semaphore render_finished_semaphore{nullptr};
 	raii::Fence draw_fence{nullptr};
 
+	// GPU time of the last frame, from timestamps around its command buffer, drives the render resolution
+	raii::QueryPool timestamp_queries{nullptr};
+	float timestamp_period = 0.0f; // Nanoseconds per tick
+	uint64_t timestamp_mask = 0;
+	bool timestamps_pending = false;
+	bool swapchain_transfer_supported = false;
+	bool swapchain_readback_supported = false; // Transfer source, for the terminal output
+	bool dynamic_resolution_supported = false;
+	DynamicResolution resolution;
+
+	// Render graph passes on the GPU track of the trace, T starts and stops tracing
+	bool calibrated_timestamps_supported = false;
+	std::optional<GpuTrace> gpu_trace;
+
+	void create_timestamp_queries();
+	void read_gpu_time();
 	void draw_frame();
+	static void save_trace();
 
 
 
@@ -115,8 +254,23 @@ private:
 		vk::KHRCreateRenderpass2ExtensionName
 	};
 
+	// Last, so a task still running when the constructor throws is waited for before anything it uses goes away
+	std::future<ShaderSource> shader_loading;
+	std::future<std::vector<char>> pipeline_cache_loading;
+	std::future<std::vector<DeviceCandidate>> device_candidates;
+
 	static constexpr unsigned int WIDTH  = 800;
 	static constexpr unsigned int HEIGHT = 600;
 
 	static constexpr bool NO_FRAMES = false;
+
+	static constexpr const char *SHADER_FILE = "shader.spv";
+	static constexpr const char *TRACE_FILE = "trace.json";
+	static constexpr const char *PIPELINE_CACHE_FILE = "pipeline_cache.bin";
+	static constexpr const char *DEVICE_CACHE_FILE = "device_capabilities.bin";
+	// Clamped to what the device supports, M cycles through the rest at runtime
+	static constexpr vk::SampleCountFlagBits MSAA_SAMPLES = vk::SampleCountFlagBits::e4;
+	static constexpr uint32_t MAX_INSTANCES = 1 << 18; // Per frame, 8 MiB of transforms
+	static constexpr uint32_t INSTANCE_GRID = 64;      // Test scene, a square grid of triangles, most of them spinning
+	static constexpr float INSTANCE_SPACING = 1.5f;
 };
\ No newline at end of file
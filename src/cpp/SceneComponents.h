@@ -0,0 +1,18 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+// Components of the objects the renderer draws, stored in an EntityWorld
+
+// Where an instance is drawn, uploaded to the InstanceBuffer whenever it changes
+struct Transform {
+	glm::quat rotation{1.0f, 0.0f, 0.0f, 0.0f};
+	glm::vec3 position{0.0f};
+	float scale = 1.0f;
+};
+
+// Keeps rotating around a fixed axis
+struct Spin {
+	glm::vec3 axis{0.0f, 1.0f, 0.0f}; // Unit length
+	float speed = 1.0f;               // Radians per second
+};
@@ -0,0 +1,275 @@
+#include "SceneTransforms.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <stdexcept>
+#include <string>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "Benchmark.h"
+#include "text_formatting.h"
+
+using namespace transform_kernels;
+
+namespace {
+	// Values of a node that was just added: identity transform, empty box
+	std::array<float, FIELD_COUNT> identity_values() {
+		std::array<float, FIELD_COUNT> values{};
+		for (const Field field : {LOCAL_ROTATION_W, LOCAL_SCALE, WORLD_ROTATION_W, WORLD_SCALE, MATRIX_00, MATRIX_11, MATRIX_22}) {
+			values[field] = 1.0f;
+		}
+		return values;
+	}
+}
+
+SceneTransforms::SceneTransforms():
+	isa(best_isa()),
+	kernel(transform_kernels::kernel(isa))
+{
+	const std::array<float, FIELD_COUNT> values = identity_values();
+	for (uint32_t field = 0; field < FIELD_COUNT; ++field) fields[field].push_back(values[field]);
+	parents.push_back(0);
+	level_ends.push_back(1);
+	slots.push_back(0);
+	nodes.push_back(ROOT);
+}
+
+SceneTransforms::Node SceneTransforms::add(const Node parent) {
+	if (parent >= slots.size()) throw std::runtime_error("Scene node " + std::to_string(parent) + " does not exist");
+
+	// One level below the parent, at the end of that level
+	const uint32_t parent_slot = slots[parent];
+	const size_t level = std::upper_bound(level_ends.begin(), level_ends.end(), parent_slot) - level_ends.begin() + 1;
+	if (level == level_ends.size()) level_ends.push_back(level_ends.back());
+	const uint32_t slot = level_ends[level];
+	for (size_t i = level; i < level_ends.size(); ++i) ++level_ends[i];
+
+	const std::array<float, FIELD_COUNT> values = identity_values();
+	for (uint32_t field = 0; field < FIELD_COUNT; ++field) {
+		fields[field].insert(fields[field].begin() + slot, values[field]);
+	}
+
+	// Only deeper nodes move, and only their parents can be at or behind the new slot
+	for (size_t i = slot; i < parents.size(); ++i) {
+		if (parents[i] >= static_cast<int32_t>(slot)) ++parents[i];
+	}
+	parents.insert(parents.begin() + slot, static_cast<int32_t>(parent_slot));
+
+	const auto node = static_cast<Node>(slots.size());
+	slots.push_back(slot);
+	nodes.insert(nodes.begin() + slot, node);
+	for (size_t i = slot + 1; i < nodes.size(); ++i) slots[nodes[i]] = static_cast<uint32_t>(i);
+
+	return node;
+}
+
+void SceneTransforms::set_local(const Node node, const glm::vec3 &position, const glm::quat &rotation, const float scale) {
+	set_position(node, position);
+	set_rotation(node, rotation);
+	set_scale(node, scale);
+}
+
+void SceneTransforms::set_position(const Node node, const glm::vec3 &position) {
+	at(LOCAL_POSITION_X, node) = position.x;
+	at(LOCAL_POSITION_Y, node) = position.y;
+	at(LOCAL_POSITION_Z, node) = position.z;
+}
+
+void SceneTransforms::set_rotation(const Node node, const glm::quat &rotation) {
+	at(LOCAL_ROTATION_X, node) = rotation.x;
+	at(LOCAL_ROTATION_Y, node) = rotation.y;
+	at(LOCAL_ROTATION_Z, node) = rotation.z;
+	at(LOCAL_ROTATION_W, node) = rotation.w;
+}
+
+void SceneTransforms::set_scale(const Node node, const float scale) {
+	at(LOCAL_SCALE, node) = scale;
+}
+
+void SceneTransforms::set_bounds(const Node node, const glm::vec3 &min, const glm::vec3 &max) {
+	const glm::vec3 center = (min + max) * 0.5f;
+	const glm::vec3 extent = (max - min) * 0.5f;
+	at(BOUNDS_CENTER_X, node) = center.x;
+	at(BOUNDS_CENTER_Y, node) = center.y;
+	at(BOUNDS_CENTER_Z, node) = center.z;
+	at(BOUNDS_EXTENT_X, node) = extent.x;
+	at(BOUNDS_EXTENT_Y, node) = extent.y;
+	at(BOUNDS_EXTENT_Z, node) = extent.z;
+}
+
+void SceneTransforms::update() {
+	Streams streams;
+	for (uint32_t field = 0; field < FIELD_COUNT; ++field) streams.fields[field] = fields[field].data();
+	streams.parents = parents.data();
+
+	// Level by level, the root keeps its identity transform
+	for (size_t level = 1; level < level_ends.size(); ++level) {
+		kernel(streams, level_ends[level - 1], level_ends[level]);
+	}
+}
+
+glm::vec3 SceneTransforms::vec3_at(const Field x, const Node node) const {
+	return {at(x, node), at(static_cast<Field>(x + 1), node), at(static_cast<Field>(x + 2), node)};
+}
+
+glm::vec3 SceneTransforms::world_position(const Node node) const {
+	return vec3_at(WORLD_POSITION_X, node);
+}
+
+glm::quat SceneTransforms::world_rotation(const Node node) const {
+	return glm::quat{
+		at(WORLD_ROTATION_W, node),
+		at(WORLD_ROTATION_X, node),
+		at(WORLD_ROTATION_Y, node),
+		at(WORLD_ROTATION_Z, node)
+	};
+}
+
+glm::mat4 SceneTransforms::world_matrix(const Node node) const {
+	glm::mat4 matrix{1.0f};
+	for (uint32_t row = 0; row < 3; ++row) {
+		for (uint32_t column = 0; column < 4; ++column) {
+			matrix[column][row] = at(static_cast<Field>(MATRIX_00 + row * 4 + column), node);
+		}
+	}
+	return matrix;
+}
+
+SceneTransforms::Aabb SceneTransforms::world_bounds(const Node node) const {
+	return {vec3_at(AABB_MIN_X, node), vec3_at(AABB_MAX_X, node)};
+}
+
+SceneTransforms::Sphere SceneTransforms::world_sphere(const Node node) const {
+	return {vec3_at(SPHERE_X, node), at(SPHERE_RADIUS, node)};
+}
+
+void SceneTransforms::use_isa(const Isa _isa) {
+	if (!supported(_isa)) throw std::runtime_error(std::string{"CPU does not support "} + name(_isa));
+	isa = _isa;
+	kernel = transform_kernels::kernel(isa);
+}
+
+
+
+namespace {
+	// What a scene graph storing one matrix per node does
+	struct NaiveNode {
+		glm::vec3 position;
+		glm::quat rotation;
+		float scale;
+		uint32_t parent;
+		glm::vec3 bounds_min;
+		glm::vec3 bounds_max;
+
+		glm::mat4 world{1.0f};
+		SceneTransforms::Aabb aabb;
+		SceneTransforms::Sphere sphere;
+	};
+
+	void naive_update(std::vector<NaiveNode> &nodes) {
+		for (size_t i = 1; i < nodes.size(); ++i) {
+			NaiveNode &node = nodes[i];
+			const glm::mat4 local = glm::scale(
+				glm::translate(glm::mat4{1.0f}, node.position) * glm::mat4_cast(node.rotation),
+				glm::vec3{node.scale}
+			);
+			node.world = nodes[node.parent].world * local;
+
+			node.aabb = {glm::vec3{INFINITY}, glm::vec3{-INFINITY}};
+			for (uint32_t corner = 0; corner < 8; ++corner) {
+				const glm::vec3 local_corner = {
+					corner & 1 ? node.bounds_max.x : node.bounds_min.x,
+					corner & 2 ? node.bounds_max.y : node.bounds_min.y,
+					corner & 4 ? node.bounds_max.z : node.bounds_min.z
+				};
+				const glm::vec3 world_corner = glm::vec3{node.world * glm::vec4{local_corner, 1.0f}};
+				node.aabb.min = glm::min(node.aabb.min, world_corner);
+				node.aabb.max = glm::max(node.aabb.max, world_corner);
+			}
+
+			const glm::vec3 center = (node.bounds_min + node.bounds_max) * 0.5f;
+			node.sphere = {
+				glm::vec3{node.world * glm::vec4{center, 1.0f}},
+				glm::length(node.bounds_max - center) * glm::length(glm::vec3{node.world[0]})
+			};
+		}
+	}
+}
+
+void benchmark_scene_transforms(const uint32_t roots, const uint32_t children, const uint32_t grandchildren) {
+	std::mt19937 random{42};
+	std::uniform_real_distribution<float> offset{-10.0f, 10.0f};
+	std::uniform_real_distribution<float> unit{-1.0f, 1.0f};
+	std::uniform_real_distribution<float> scale{0.5f, 2.0f};
+
+	SceneTransforms scene;
+	std::vector<NaiveNode> naive(1);
+	naive[0].parent = 0;
+
+	const auto add = [&](const SceneTransforms::Node parent) {
+		const glm::vec3 position = {offset(random), offset(random), offset(random)};
+		const glm::quat rotation = glm::normalize(glm::quat{unit(random), unit(random), unit(random), unit(random)});
+		const float node_scale = scale(random);
+		const glm::vec3 half = {scale(random), scale(random), scale(random)};
+		const glm::vec3 center = {unit(random), unit(random), unit(random)};
+
+		const SceneTransforms::Node node = scene.add(parent);
+		scene.set_local(node, position, rotation, node_scale);
+		scene.set_bounds(node, center - half, center + half);
+		naive.push_back({position, rotation, node_scale, parent, center - half, center + half, glm::mat4{1.0f}, {}, {}});
+		return node;
+	};
+
+	// Whole levels at a time keeps every add at the end of the storage, and node handles equal naive indices
+	std::vector<SceneTransforms::Node> level;
+	for (uint32_t i = 0; i < roots; ++i) level.push_back(add(SceneTransforms::ROOT));
+	for (const uint32_t count : {children, grandchildren}) {
+		std::vector<SceneTransforms::Node> next;
+		for (const SceneTransforms::Node parent : level) {
+			for (uint32_t i = 0; i < count; ++i) next.push_back(add(parent));
+		}
+		level = std::move(next);
+	}
+
+	const double node_count = static_cast<double>(scene.size());
+	const auto per_node = [&](const double ms) { return benchmark::format("%7.2f", ms * 1e6 / node_count) + " ns/node"; };
+
+	wnd::begin("Scene transform benchmark", wnd::none, 64);
+	wnd::begin_section("Hierarchy:");
+	wnd::print("Nodes:  " + std::to_string(scene.size()));
+	wnd::print("Levels: 3 (" + std::to_string(roots) + " x " + std::to_string(children) + " x " + std::to_string(grandchildren) + ")");
+	wnd::print();
+
+	const double naive_ms = benchmark::time_ms([&] { naive_update(naive); });
+	wnd::begin_section("World transforms, boxes and spheres:");
+	wnd::print(wnd::set_length("glm::mat4 per node", 20) + per_node(naive_ms));
+
+	for (const Isa isa : {Isa::Scalar, Isa::Sse2, Isa::Avx2}) {
+		if (!supported(isa)) {
+			wnd::print(wnd::set_length(std::string{"SoA "} + name(isa), 20) + "not supported");
+			continue;
+		}
+		scene.use_isa(isa);
+		const double ms = benchmark::time_ms([&] { scene.update(); });
+
+		// Both compute the same bounds up to rounding
+		float error = 0.0f;
+		for (SceneTransforms::Node node = 1; node <= scene.size(); ++node) {
+			const SceneTransforms::Aabb bounds = scene.world_bounds(node);
+			error = std::max({
+				error,
+				glm::length(bounds.min - naive[node].aabb.min),
+				glm::length(bounds.max - naive[node].aabb.max),
+				std::abs(scene.world_sphere(node).radius - naive[node].sphere.radius)
+			});
+		}
+
+		wnd::print(
+			wnd::set_length(std::string{"SoA "} + name(isa), 20) + per_node(ms)
+			+ benchmark::format("  %5.1fx", naive_ms / ms) + benchmark::format("  error %.1e", error)
+		);
+	}
+	wnd::end();
+}
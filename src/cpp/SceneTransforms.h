@@ -0,0 +1,78 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include "TransformKernels.h"
+
+// Transform hierarchy of the scene. Each node has a position, rotation and uniform scale relative to its parent
+// and a box in its own space. update() computes every world transform, world matrix, bounding box and bounding
+// sphere with SIMD kernels, picking the widest instruction set the CPU supports at runtime.
+// Nodes are stored sorted by depth, so every level of the hierarchy is one contiguous range whose parents are
+// final before the range is processed. Node handles stay valid while the storage behind them is reordered.
+class SceneTransforms {
+public:
+	using Node = uint32_t;
+	// The identity transform every top level node hangs from
+	static constexpr Node ROOT = 0;
+
+	struct Aabb {
+		glm::vec3 min;
+		glm::vec3 max;
+	};
+
+	struct Sphere {
+		glm::vec3 center;
+		float radius;
+	};
+
+private:
+	using Field = transform_kernels::Field;
+
+	std::array<std::vector<float>, transform_kernels::FIELD_COUNT> fields;
+	std::vector<int32_t> parents;     // Storage index of each node's parent
+	std::vector<uint32_t> level_ends; // Storage ranges of the levels, level 0 is only the root
+	std::vector<uint32_t> slots;      // Storage index of each node
+	std::vector<Node> nodes;          // Node at each storage index
+	transform_kernels::Isa isa;
+	transform_kernels::Kernel kernel;
+
+	[[nodiscard]] float &at(Field field, Node node) { return fields[field][slots[node]]; }
+	[[nodiscard]] float at(Field field, Node node) const { return fields[field][slots[node]]; }
+	[[nodiscard]] glm::vec3 vec3_at(Field x, Node node) const;
+
+public:
+	SceneTransforms();
+
+	// Cheapest when nodes are added in order of depth, adding to a shallower level moves every deeper node
+	Node add(Node parent = ROOT);
+	[[nodiscard]] size_t size() const { return nodes.size() - 1; }
+
+	void set_local(Node node, const glm::vec3 &position, const glm::quat &rotation, float scale = 1.0f);
+	void set_position(Node node, const glm::vec3 &position);
+	void set_rotation(Node node, const glm::quat &rotation);
+	void set_scale(Node node, float scale);
+	// Box around the node's content in its own space
+	void set_bounds(Node node, const glm::vec3 &min, const glm::vec3 &max);
+
+	// Recomputes every world space value from the local ones
+	void update();
+
+	// Valid after update()
+	[[nodiscard]] glm::vec3 world_position(Node node) const;
+	[[nodiscard]] glm::quat world_rotation(Node node) const;
+	[[nodiscard]] float world_scale(Node node) const { return at(transform_kernels::WORLD_SCALE, node); }
+	[[nodiscard]] glm::mat4 world_matrix(Node node) const;
+	[[nodiscard]] Aabb world_bounds(Node node) const;
+	[[nodiscard]] Sphere world_sphere(Node node) const;
+
+	void use_isa(transform_kernels::Isa _isa);
+	[[nodiscard]] transform_kernels::Isa current_isa() const { return isa; }
+};
+
+// Times update() with every supported instruction set against composing a glm::mat4 per node and transforming
+// all eight box corners, on a hierarchy of roots with children and grandchildren. Prints to stdout.
+void benchmark_scene_transforms(uint32_t roots = 1024, uint32_t children = 16, uint32_t grandchildren = 4);
@@ -0,0 +1,73 @@
+#include "ShaderPermutation.h"
+
+#include <algorithm>
+#include <bit>
+#include <stdexcept>
+#include <string>
+
+ShaderPermutation &ShaderPermutation::set(const uint32_t constant_id, const uint32_t value) {
+	values[constant_id] = value;
+	return *this;
+}
+
+ShaderPermutation &ShaderPermutation::set(const uint32_t constant_id, const int value) {
+	return set(constant_id, std::bit_cast<uint32_t>(value));
+}
+
+ShaderPermutation &ShaderPermutation::set(const uint32_t constant_id, const float value) {
+	return set(constant_id, std::bit_cast<uint32_t>(value));
+}
+
+ShaderPermutation &ShaderPermutation::set(const uint32_t constant_id, const bool value) {
+	return set(constant_id, value ? 1u : 0u);
+}
+
+size_t ShaderPermutation::hash() const {
+	// FNV-1a over the (id, value) pairs
+	size_t hash = 14695981039346656037ull;
+	for (const auto &[id, value] : values) {
+		hash = (hash ^ id) * 1099511628211ull;
+		hash = (hash ^ value) * 1099511628211ull;
+	}
+	return hash;
+}
+
+vk::SpecializationInfo ShaderPermutation::Specialization::info() const {
+	return {
+		static_cast<uint32_t>(entries.size()),
+		entries.data(),
+		data.size() * sizeof(uint32_t),
+		data.data()
+	};
+}
+
+ShaderPermutation::Specialization ShaderPermutation::specialize(const spirv::Module &module) const {
+	Specialization specialization;
+	specialization.entries.reserve(values.size());
+	specialization.data.reserve(values.size());
+
+	for (const auto &[id, value] : values) {
+		const auto constant = std::ranges::find(module.specialization_constants, id, &spirv::SpecializationConstant::id);
+		if (constant == module.specialization_constants.end())
+			throw std::runtime_error("Shader has no specialization constant " + std::to_string(id) + "!");
+		if (constant->size != sizeof(uint32_t))
+			throw std::runtime_error("Only 32-bit specialization constants are supported!");
+
+		specialization.entries.emplace_back(
+			id,
+			static_cast<uint32_t>(specialization.data.size() * sizeof(uint32_t)),
+			sizeof(uint32_t));
+		specialization.data.push_back(value);
+	}
+
+	return specialization;
+}
+
+std::string ShaderPermutation::to_string() const {
+	std::string out;
+	for (const auto &[id, value] : values) {
+		if (!out.empty()) out += ", ";
+		out += std::to_string(id) + "=" + std::to_string(value);
+	}
+	return "{" + out + "}";
+}
@@ -0,0 +1,40 @@
+#pragma once
+#include <map>
+#include <string>
+#include <vector>
+
+#include <vulkan/vulkan.hpp>
+
+#include "SpirvReflection.h"
+
+// Specialization constant values selecting one variant of a shader. Constants left unset keep their defaults.
+class ShaderPermutation {
+	std::map<uint32_t, uint32_t> values; // constant_id -> raw 32-bit value
+
+public:
+	ShaderPermutation &set(uint32_t constant_id, uint32_t value);
+	ShaderPermutation &set(uint32_t constant_id, int value);
+	ShaderPermutation &set(uint32_t constant_id, float value);
+	ShaderPermutation &set(uint32_t constant_id, bool value);
+
+	[[nodiscard]] bool empty() const { return values.empty(); }
+	[[nodiscard]] size_t hash() const;
+	bool operator==(const ShaderPermutation &) const = default;
+
+	struct Hash {
+		size_t operator()(const ShaderPermutation &permutation) const { return permutation.hash(); }
+	};
+
+	// Storage behind a vk::SpecializationInfo, keep it alive until the pipeline is created
+	struct Specialization {
+		std::vector<vk::SpecializationMapEntry> entries;
+		std::vector<uint32_t> data;
+
+		[[nodiscard]] vk::SpecializationInfo info() const;
+	};
+
+	// Throws if a value targets a constant the module does not declare
+	[[nodiscard]] Specialization specialize(const spirv::Module &module) const;
+
+	[[nodiscard]] std::string to_string() const;
+};
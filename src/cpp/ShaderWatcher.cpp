@@ -0,0 +1,49 @@
+#include "ShaderWatcher.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <stdexcept>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+ShaderWatcher::ShaderWatcher(std::filesystem::path _directory):
+	directory(std::move(_directory))
+{
+	inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (inotify_fd < 0) throw std::runtime_error("failed to initialise inotify!");
+
+	// slangc writes the output in place, other tools tend to write a temporary and rename it over
+	watch_descriptor = inotify_add_watch(inotify_fd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+	if (watch_descriptor < 0) {
+		close(inotify_fd);
+		throw std::runtime_error("failed to watch shader directory!");
+	}
+}
+
+ShaderWatcher::~ShaderWatcher() {
+	if (watch_descriptor >= 0) inotify_rm_watch(inotify_fd, watch_descriptor);
+	if (inotify_fd >= 0) close(inotify_fd);
+}
+
+std::vector<std::string> ShaderWatcher::poll() const {
+	std::vector<std::string> changed;
+
+	alignas(inotify_event) char buffer[4096];
+
+	while (true) {
+		const ssize_t length = read(inotify_fd, buffer, sizeof(buffer));
+		if (length <= 0) break; // EAGAIN - nothing more queued
+
+		for (ssize_t offset = 0; offset < length;) {
+			const auto *event = reinterpret_cast<const inotify_event *>(buffer + offset);
+			offset += static_cast<ssize_t>(sizeof(inotify_event) + event->len);
+
+			if (event->len == 0) continue;
+			const std::string name{event->name};
+			if (!name.ends_with(".spv")) continue;
+			if (std::ranges::find(changed, name) == changed.end()) changed.push_back(name);
+		}
+	}
+
+	return changed;
+}
@@ -0,0 +1,20 @@
+#pragma once
+#include <filesystem>
+#include <string>
+#include <vector>
+
+// Watches a directory (non-recursively) for rewritten shader binaries using inotify.
+class ShaderWatcher {
+	int inotify_fd = -1;
+	int watch_descriptor = -1;
+	std::filesystem::path directory;
+
+public:
+	explicit ShaderWatcher(std::filesystem::path _directory = ".");
+	ShaderWatcher(const ShaderWatcher &) = delete;
+	ShaderWatcher &operator=(const ShaderWatcher &) = delete;
+	~ShaderWatcher();
+
+	// Never blocks. Returns every *.spv file that was closed after writing (or moved in) since the last call.
+	[[nodiscard]] std::vector<std::string> poll() const;
+};
@@ -0,0 +1,511 @@
+#include "SpirvReflection.h"
+
+#include <algorithm>
+#include <map>
+#include <optional>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace spirv {
+	namespace {
+		constexpr uint32_t MAGIC = 0x07230203;
+		constexpr uint32_t VERSION_1_4 = 0x00010400;
+
+		enum Op : uint16_t {
+			OpEntryPoint = 15,
+			OpTypeBool = 20,
+			OpTypeInt = 21,
+			OpTypeFloat = 22,
+			OpTypeVector = 23,
+			OpTypeMatrix = 24,
+			OpTypeImage = 25,
+			OpTypeSampler = 26,
+			OpTypeSampledImage = 27,
+			OpTypeArray = 28,
+			OpTypeRuntimeArray = 29,
+			OpTypeStruct = 30,
+			OpTypePointer = 32,
+			OpConstant = 43,
+			OpSpecConstantTrue = 48,
+			OpSpecConstantFalse = 49,
+			OpSpecConstant = 50,
+			OpVariable = 59,
+			OpDecorate = 71,
+			OpMemberDecorate = 72,
+			OpTypeAccelerationStructureKHR = 5341,
+		};
+
+		enum Decoration : uint32_t {
+			SpecId = 1,
+			Block = 2,
+			BufferBlock = 3,
+			ArrayStride = 6,
+			MatrixStride = 7,
+			BuiltIn = 11,
+			Location = 30,
+			Binding = 33,
+			DescriptorSet = 34,
+			Offset = 35,
+		};
+
+		enum StorageClass : uint32_t {
+			UniformConstant = 0,
+			Input = 1,
+			Uniform = 2,
+			PushConstant = 9,
+			StorageBuffer = 12,
+		};
+
+		enum Dim : uint32_t {
+			DimBuffer = 5,
+			DimSubpassData = 6,
+		};
+
+		struct Type {
+			uint16_t op{};
+			std::vector<uint32_t> operands; // Instruction words after the result id
+		};
+
+		struct Decorations {
+			std::optional<uint32_t> spec_id, location, binding, set, array_stride, matrix_stride;
+			bool block = false, buffer_block = false, built_in = false;
+			std::map<uint32_t, uint32_t> member_offsets;
+			std::map<uint32_t, uint32_t> member_matrix_strides;
+		};
+
+		struct Variable {
+			uint32_t id;
+			uint32_t pointer_type;
+			StorageClass storage;
+		};
+
+		struct Parser {
+			std::unordered_map<uint32_t, Type> types;
+			std::unordered_map<uint32_t, uint32_t> constants;
+			std::unordered_map<uint32_t, Decorations> decorations;
+			std::vector<Variable> variables;
+
+			struct SpecConstant {
+				uint32_t id;
+				uint32_t type;
+				uint32_t value;
+			};
+			std::vector<SpecConstant> spec_constants;
+
+			struct RawEntryPoint {
+				uint32_t model;
+				std::string name;
+				std::vector<uint32_t> interface;
+			};
+			std::vector<RawEntryPoint> entries;
+
+			const Type &type(const uint32_t id) const {
+				const auto it = types.find(id);
+				if (it == types.end()) throw std::runtime_error("SPIR-V reflection: unknown type id");
+				return it->second;
+			}
+
+			uint32_t array_length(const Type &array) const {
+				const auto it = constants.find(array.operands[1]);
+				if (it == constants.end()) throw std::runtime_error("SPIR-V reflection: array length is not a constant");
+				return it->second;
+			}
+
+			// Size of a type as laid out in a Block with explicit offsets
+			uint32_t size_of(const uint32_t id, const std::optional<uint32_t> matrix_stride = {}) const {
+				const Type &t = type(id);
+				switch (t.op) {
+					case OpTypeBool: return 4;
+					case OpTypeInt:
+					case OpTypeFloat: return t.operands[0] / 8;
+					case OpTypeVector: return size_of(t.operands[0]) * t.operands[1];
+					case OpTypeMatrix:
+						return (matrix_stride ? *matrix_stride : size_of(t.operands[0])) * t.operands[1];
+					case OpTypeArray: {
+						const auto it = decorations.find(id);
+						const uint32_t stride = it != decorations.end() && it->second.array_stride
+							? *it->second.array_stride
+							: size_of(t.operands[0]);
+						return stride * array_length(t);
+					}
+					case OpTypeStruct: {
+						uint32_t end = 0;
+						const Decorations *d = decorations.contains(id) ? &decorations.at(id) : nullptr;
+						for (uint32_t member = 0; member < t.operands.size(); member++) {
+							uint32_t offset = 0;
+							std::optional<uint32_t> stride;
+							if (d && d->member_offsets.contains(member)) offset = d->member_offsets.at(member);
+							if (d && d->member_matrix_strides.contains(member))
+								stride = d->member_matrix_strides.at(member);
+							end = std::max(end, offset + size_of(t.operands[member], stride));
+						}
+						return end;
+					}
+					case OpTypePointer: return 8; // Only physical storage buffer pointers can sit in a block
+					default: throw std::runtime_error("SPIR-V reflection: type has no size");
+				}
+			}
+
+			// First member offset of a push constant block
+			uint32_t first_offset(const uint32_t struct_id) const {
+				const auto it = decorations.find(struct_id);
+				if (it == decorations.end() || it->second.member_offsets.empty()) return 0;
+				uint32_t offset = UINT32_MAX;
+				for (const auto &[member, member_offset] : it->second.member_offsets)
+					offset = std::min(offset, member_offset);
+				return offset;
+			}
+
+			vk::DescriptorType descriptor_type(const Type &t, const uint32_t type_id, const StorageClass storage) const {
+				if (storage == StorageBuffer) return vk::DescriptorType::eStorageBuffer;
+				if (storage == Uniform) {
+					const auto it = decorations.find(type_id);
+					if (it != decorations.end() && it->second.buffer_block) return vk::DescriptorType::eStorageBuffer;
+					return vk::DescriptorType::eUniformBuffer;
+				}
+
+				switch (t.op) {
+					case OpTypeSampler: return vk::DescriptorType::eSampler;
+					case OpTypeSampledImage: {
+						const Type &image = type(t.operands[0]);
+						if (image.operands[1] == DimBuffer) return vk::DescriptorType::eUniformTexelBuffer;
+						return vk::DescriptorType::eCombinedImageSampler;
+					}
+					case OpTypeImage:
+						if (t.operands[1] == DimSubpassData) return vk::DescriptorType::eInputAttachment;
+						if (t.operands[1] == DimBuffer)
+							return t.operands[5] == 2 ? vk::DescriptorType::eStorageTexelBuffer
+													  : vk::DescriptorType::eUniformTexelBuffer;
+						return t.operands[5] == 2 ? vk::DescriptorType::eStorageImage : vk::DescriptorType::eSampledImage;
+					case OpTypeAccelerationStructureKHR: return vk::DescriptorType::eAccelerationStructureKHR;
+					default: throw std::runtime_error("SPIR-V reflection: unsupported descriptor type");
+				}
+			}
+
+			vk::Format vertex_format(const Type &t) const {
+				uint32_t components = 1;
+				const Type *scalar = &t;
+				if (t.op == OpTypeVector) {
+					components = t.operands[1];
+					scalar = &type(t.operands[0]);
+				}
+
+				if (scalar->operands[0] != 32) throw std::runtime_error("SPIR-V reflection: only 32-bit vertex inputs");
+
+				constexpr vk::Format floats[] = {
+					vk::Format::eR32Sfloat, vk::Format::eR32G32Sfloat,
+					vk::Format::eR32G32B32Sfloat, vk::Format::eR32G32B32A32Sfloat
+				};
+				constexpr vk::Format sints[] = {
+					vk::Format::eR32Sint, vk::Format::eR32G32Sint,
+					vk::Format::eR32G32B32Sint, vk::Format::eR32G32B32A32Sint
+				};
+				constexpr vk::Format uints[] = {
+					vk::Format::eR32Uint, vk::Format::eR32G32Uint,
+					vk::Format::eR32G32B32Uint, vk::Format::eR32G32B32A32Uint
+				};
+
+				if (scalar->op == OpTypeFloat) return floats[components - 1];
+				if (scalar->op == OpTypeInt) return scalar->operands[1] ? sints[components - 1] : uints[components - 1];
+				throw std::runtime_error("SPIR-V reflection: unsupported vertex input type");
+			}
+
+			// Operand words after the opcode that the reflection reads for each type, operands past these are optional
+			static size_t type_words(const uint16_t op) {
+				switch (op) {
+					case OpTypeFloat:
+					case OpTypeSampledImage:
+					case OpTypeRuntimeArray: return 2;
+					case OpTypeInt:
+					case OpTypeVector:
+					case OpTypeMatrix:
+					case OpTypeArray:
+					case OpTypePointer: return 3;
+					case OpTypeImage: return 8;
+					default: return 1;
+				}
+			}
+
+			static void require(const std::span<const uint32_t> words, const size_t count) {
+				if (words.size() < count) throw std::runtime_error("SPIR-V reflection: malformed instruction");
+			}
+
+			void parse(const std::span<const uint32_t> code) {
+				size_t i = 5;
+				while (i < code.size()) {
+					const uint32_t word_count = code[i] >> 16;
+					const auto op = static_cast<uint16_t>(code[i] & 0xFFFF);
+					if (word_count == 0 || i + word_count > code.size())
+						throw std::runtime_error("SPIR-V reflection: malformed instruction");
+					const std::span<const uint32_t> words = code.subspan(i + 1, word_count - 1);
+					i += word_count;
+
+					switch (op) {
+						case OpEntryPoint: {
+							require(words, 3);
+							RawEntryPoint entry{words[0], {}, {}};
+
+							// The name is NUL terminated and padded to whole words, the interface ids follow it
+							const std::span<const uint32_t> name_words = words.subspan(2);
+							const auto *chars = reinterpret_cast<const char *>(name_words.data());
+							const char *end = chars + name_words.size_bytes();
+							const char *nul = std::find(chars, end, '\0');
+							if (nul == end) throw std::runtime_error("SPIR-V reflection: malformed instruction");
+							entry.name.assign(chars, nul);
+							const size_t w = 2 + entry.name.size() / 4 + 1; // At most words.size(), the NUL is inside
+							entry.interface.assign(words.begin() + static_cast<long>(w), words.end());
+							entries.push_back(std::move(entry));
+							break;
+						}
+						case OpTypeBool:
+						case OpTypeInt:
+						case OpTypeFloat:
+						case OpTypeVector:
+						case OpTypeMatrix:
+						case OpTypeImage:
+						case OpTypeSampler:
+						case OpTypeSampledImage:
+						case OpTypeArray:
+						case OpTypeRuntimeArray:
+						case OpTypeStruct:
+						case OpTypePointer:
+						case OpTypeAccelerationStructureKHR:
+							require(words, type_words(op));
+							types[words[0]] = Type{op, {words.begin() + 1, words.end()}};
+							break;
+						case OpConstant:
+							require(words, 3);
+							constants[words[1]] = words[2];
+							break;
+						case OpSpecConstantTrue:
+						case OpSpecConstantFalse:
+							require(words, 2);
+							spec_constants.push_back({words[1], words[0], op == OpSpecConstantTrue ? 1u : 0u});
+							break;
+						case OpSpecConstant:
+							require(words, 3);
+							spec_constants.push_back({words[1], words[0], words[2]});
+							break;
+						case OpVariable:
+							require(words, 3);
+							variables.push_back({words[1], words[0], static_cast<StorageClass>(words[2])});
+							break;
+						case OpDecorate: {
+							require(words, 2);
+							const uint32_t decoration = words[1];
+							if (decoration == SpecId || decoration == ArrayStride || decoration == Location ||
+								decoration == Binding || decoration == DescriptorSet) require(words, 3);
+							Decorations &d = decorations[words[0]];
+							switch (decoration) {
+								case SpecId: d.spec_id = words[2]; break;
+								case Block: d.block = true; break;
+								case BufferBlock: d.buffer_block = true; break;
+								case ArrayStride: d.array_stride = words[2]; break;
+								case BuiltIn: d.built_in = true; break;
+								case Location: d.location = words[2]; break;
+								case Binding: d.binding = words[2]; break;
+								case DescriptorSet: d.set = words[2]; break;
+								default: break;
+							}
+							break;
+						}
+						case OpMemberDecorate: {
+							require(words, 3);
+							if (words[2] == Offset || words[2] == MatrixStride) require(words, 4);
+							Decorations &d = decorations[words[0]];
+							if (words[2] == Offset) d.member_offsets[words[1]] = words[3];
+							if (words[2] == MatrixStride) d.member_matrix_strides[words[1]] = words[3];
+							if (words[2] == BuiltIn) d.built_in = true;
+							break;
+						}
+						default: break;
+					}
+				}
+			}
+
+			static vk::ShaderStageFlagBits stage(const uint32_t model) {
+				switch (model) {
+					case 0: return vk::ShaderStageFlagBits::eVertex;
+					case 1: return vk::ShaderStageFlagBits::eTessellationControl;
+					case 2: return vk::ShaderStageFlagBits::eTessellationEvaluation;
+					case 3: return vk::ShaderStageFlagBits::eGeometry;
+					case 4: return vk::ShaderStageFlagBits::eFragment;
+					case 5: return vk::ShaderStageFlagBits::eCompute;
+					case 5364: return vk::ShaderStageFlagBits::eTaskEXT;
+					case 5365: return vk::ShaderStageFlagBits::eMeshEXT;
+					default: throw std::runtime_error("SPIR-V reflection: unsupported execution model");
+				}
+			}
+
+			EntryPoint entry_point(const RawEntryPoint &raw, const bool resources_in_interface) const {
+				EntryPoint entry{raw.name, stage(raw.model), {}, {}, {}};
+
+				for (const Variable &variable : variables) {
+					const bool in_interface = std::ranges::find(raw.interface, variable.id) != raw.interface.end();
+					const Type &pointer = type(variable.pointer_type);
+					const uint32_t pointee_id = pointer.operands[1];
+					const auto decoration = decorations.find(variable.id);
+
+					switch (variable.storage) {
+						case UniformConstant:
+						case Uniform:
+						case StorageBuffer: {
+							if (resources_in_interface && !in_interface) break;
+							if (decoration == decorations.end() || !decoration->second.binding) break;
+
+							uint32_t element_id = pointee_id;
+							uint32_t count = 1;
+							const Type *element = &type(element_id);
+							if (element->op == OpTypeRuntimeArray)
+								throw std::runtime_error("SPIR-V reflection: runtime descriptor arrays are not supported");
+							if (element->op == OpTypeArray) {
+								count = array_length(*element);
+								element_id = element->operands[0];
+								element = &type(element_id);
+							}
+
+							entry.bindings.push_back({
+								decoration->second.set.value_or(0),
+								*decoration->second.binding,
+								descriptor_type(*element, element_id, variable.storage),
+								count,
+								entry.stage
+							});
+							break;
+						}
+						case PushConstant: {
+							if (resources_in_interface && !in_interface) break;
+							const uint32_t offset = first_offset(pointee_id);
+							entry.push_constants.emplace_back(entry.stage, offset, size_of(pointee_id) - offset);
+							break;
+						}
+						case Input: {
+							if (!in_interface || entry.stage != vk::ShaderStageFlagBits::eVertex) break;
+							if (decoration == decorations.end() || decoration->second.built_in) break;
+							if (!decoration->second.location) break;
+							if (decorations.contains(pointee_id) && decorations.at(pointee_id).built_in) break;
+
+							const Type &input = type(pointee_id);
+							if (input.op == OpTypeMatrix) {
+								// Matrices take one location per column
+								const Type &column = type(input.operands[0]);
+								for (uint32_t c = 0; c < input.operands[1]; c++) {
+									entry.vertex_inputs.push_back({
+										*decoration->second.location + c,
+										vertex_format(column),
+										size_of(input.operands[0])
+									});
+								}
+							} else {
+								entry.vertex_inputs.push_back({
+									*decoration->second.location,
+									vertex_format(input),
+									size_of(pointee_id)
+								});
+							}
+							break;
+						}
+						default: break;
+					}
+				}
+
+				std::ranges::sort(entry.bindings, {}, [](const DescriptorBinding &b) {
+					return std::pair{b.set, b.binding};
+				});
+				std::ranges::sort(entry.vertex_inputs, {}, &VertexInput::location);
+
+				return entry;
+			}
+		};
+	}
+
+
+
+	const EntryPoint &Module::entry_point(const vk::ShaderStageFlagBits stage) const {
+		const auto it = std::ranges::find(entry_points, stage, &EntryPoint::stage);
+		if (it == entry_points.end())
+			throw std::runtime_error("Shader module has no " + vk::to_string(stage) + " entry point!");
+		return *it;
+	}
+
+
+
+	Module reflect(const std::span<const uint32_t> code) {
+		if (code.size() < 5 || code[0] != MAGIC) throw std::runtime_error("Not a SPIR-V module!");
+
+		Parser parser;
+		parser.parse(code);
+
+		// Before SPIR-V 1.4 the entry point interface only lists Input/Output variables,
+		// so every resource is assumed to be used by every entry point
+		const bool resources_in_interface = code[1] >= VERSION_1_4;
+
+		Module reflected;
+		for (const auto &raw : parser.entries) {
+			reflected.entry_points.push_back(parser.entry_point(raw, resources_in_interface));
+		}
+
+		for (const auto &constant : parser.spec_constants) {
+			const auto decoration = parser.decorations.find(constant.id);
+			if (decoration == parser.decorations.end() || !decoration->second.spec_id) continue;
+			reflected.specialization_constants.push_back({
+				*decoration->second.spec_id,
+				parser.size_of(constant.type),
+				constant.value
+			});
+		}
+		std::ranges::sort(reflected.specialization_constants, {}, &SpecializationConstant::id);
+
+		return reflected;
+	}
+
+
+
+	Module reflect(const std::span<const char> code) {
+		if (code.size() % 4) throw std::runtime_error("SPIR-V size is not a multiple of 4!");
+		return reflect(std::span{reinterpret_cast<const uint32_t *>(code.data()), code.size() / 4});
+	}
+
+
+
+	PipelineInterface merge(const std::span<const EntryPoint *const> entry_points) {
+		PipelineInterface interface;
+
+		vk::ShaderStageFlags push_stages;
+		uint32_t push_begin = UINT32_MAX;
+		uint32_t push_end = 0;
+
+		for (const EntryPoint *entry : entry_points) {
+			for (const DescriptorBinding &binding : entry->bindings) {
+				if (interface.sets.size() <= binding.set) interface.sets.resize(binding.set + 1);
+				auto &set = interface.sets[binding.set];
+
+				const auto it = std::ranges::find(set, binding.binding, &vk::DescriptorSetLayoutBinding::binding);
+				if (it == set.end()) {
+					set.emplace_back(binding.binding, binding.type, binding.count, binding.stages);
+				} else {
+					if (it->descriptorType != binding.type || it->descriptorCount != binding.count)
+						throw std::runtime_error("Shader stages disagree about a descriptor binding!");
+					it->stageFlags |= binding.stages;
+				}
+			}
+
+			// One range visible to every stage that uses push constants keeps the layout valid and shareable
+			for (const vk::PushConstantRange &range : entry->push_constants) {
+				push_stages |= range.stageFlags;
+				push_begin = std::min(push_begin, range.offset);
+				push_end = std::max(push_end, range.offset + range.size);
+			}
+
+			if (entry->stage == vk::ShaderStageFlagBits::eVertex) interface.vertex_inputs = entry->vertex_inputs;
+		}
+
+		for (auto &set : interface.sets) {
+			std::ranges::sort(set, {}, &vk::DescriptorSetLayoutBinding::binding);
+		}
+
+		if (push_stages) interface.push_constants.emplace_back(push_stages, push_begin, push_end - push_begin);
+
+		return interface;
+	}
+}
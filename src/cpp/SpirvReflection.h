@@ -0,0 +1,57 @@
+#pragma once
+#include <span>
+#include <string>
+#include <vector>
+
+#include <vulkan/vulkan.hpp>
+
+// Minimal SPIR-V binary parser extracting what is needed to build pipeline layouts and vertex input state.
+namespace spirv {
+	struct DescriptorBinding {
+		unsigned int set;
+		unsigned int binding;
+		vk::DescriptorType type;
+		unsigned int count;
+		vk::ShaderStageFlags stages;
+	};
+
+	struct VertexInput {
+		unsigned int location;
+		vk::Format format;
+		unsigned int size; // In bytes
+	};
+
+	struct EntryPoint {
+		std::string name;
+		vk::ShaderStageFlagBits stage;
+		std::vector<DescriptorBinding> bindings;
+		std::vector<vk::PushConstantRange> push_constants;
+		std::vector<VertexInput> vertex_inputs; // Vertex stage only, sorted by location
+	};
+
+	struct SpecializationConstant {
+		unsigned int id;
+		unsigned int size; // In bytes, booleans are VkBool32
+		uint32_t default_value;
+	};
+
+	struct Module {
+		std::vector<EntryPoint> entry_points;
+		std::vector<SpecializationConstant> specialization_constants; // Sorted by id
+
+		// Throws if the module has no entry point for the stage
+		[[nodiscard]] const EntryPoint &entry_point(vk::ShaderStageFlagBits stage) const;
+	};
+
+	// Everything a pipeline built from several entry points exposes, merged across stages
+	struct PipelineInterface {
+		std::vector<std::vector<vk::DescriptorSetLayoutBinding>> sets; // Indexed by set number, sorted by binding
+		std::vector<vk::PushConstantRange> push_constants;
+		std::vector<VertexInput> vertex_inputs;
+	};
+
+	[[nodiscard]] Module reflect(std::span<const uint32_t> code);
+	[[nodiscard]] Module reflect(std::span<const char> code);
+
+	[[nodiscard]] PipelineInterface merge(std::span<const EntryPoint *const> entry_points);
+}
@@ -0,0 +1,364 @@
+#include "TerminalOutput.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <stdexcept>
+#include <string_view>
+#include <utility>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "Trace.h"
+
+namespace {
+	// Dropping the low bits of each channel keeps noise from redrawing cells that look the same
+	constexpr uint32_t COLOR_MASK = 0xFCFCFC;
+	constexpr std::u32string_view LUMINANCE_RAMP = U" .:-=+*#%@";
+
+	uint8_t average(const uint8_t a, const uint8_t b) {
+		return static_cast<uint8_t>((a + b + 1) >> 1);
+	}
+
+	void downsample_scalar(const uint8_t *upper, const uint8_t *lower, const uint32_t count, uint8_t *out) {
+		for (uint32_t i = 0; i < count * 4; i++) {
+			const uint32_t left = 2 * i - i % 4; // Same channel of the left pixel of the block
+			out[i] = average(average(upper[left], lower[left]), average(upper[left + 4], lower[left + 4]));
+		}
+	}
+
+	// Framebuffer pixels are RGBA in memory
+	uint32_t board_color(const uint32_t pixel) {
+		return ((pixel & 0xFF) << 16 | (pixel & 0xFF00) | (pixel >> 16 & 0xFF)) & COLOR_MASK;
+	}
+
+	uint32_t luminance(const uint32_t pixel) {
+		return (54 * (pixel & 0xFF) + 183 * (pixel >> 8 & 0xFF) + 19 * (pixel >> 16 & 0xFF)) >> 8;
+	}
+
+	vk::Format readback_format_for(const vk::Format source_format) {
+		// The blit converts, an sRGB source has to land in sRGB bytes as the terminal expects them
+		switch (source_format) {
+			case vk::Format::eB8G8R8A8Srgb:
+			case vk::Format::eR8G8B8A8Srgb:
+			case vk::Format::eA8B8G8R8SrgbPack32:
+				return vk::Format::eR8G8B8A8Srgb;
+			default:
+				return vk::Format::eR8G8B8A8Unorm;
+		}
+	}
+
+	vk::Offset3D corner(const vk::Extent2D size) {
+		return {static_cast<int32_t>(size.width), static_cast<int32_t>(size.height), 1};
+	}
+}
+
+void downsample_2x2(const uint8_t *source, const uint32_t width, const uint32_t height, uint32_t *destination) {
+	const size_t source_stride = static_cast<size_t>(width) * 2 * 4;
+	for (uint32_t row = 0; row < height; row++) {
+		const uint8_t *upper = source + 2 * row * source_stride;
+		const uint8_t *lower = upper + source_stride;
+		uint32_t *out = destination + static_cast<size_t>(row) * width;
+
+		uint32_t done = 0;
+#ifdef __SSE2__
+		// Four output pixels from eight source pixels of both rows: average the rows, then split even and odd pixels
+		// apart and average those
+		for (; done + 4 <= width; done += 4) {
+			const __m128i first = _mm_avg_epu8(
+				_mm_loadu_si128(reinterpret_cast<const __m128i *>(upper + done * 8)),
+				_mm_loadu_si128(reinterpret_cast<const __m128i *>(lower + done * 8)));
+			const __m128i second = _mm_avg_epu8(
+				_mm_loadu_si128(reinterpret_cast<const __m128i *>(upper + done * 8 + 16)),
+				_mm_loadu_si128(reinterpret_cast<const __m128i *>(lower + done * 8 + 16)));
+			const __m128 even = _mm_shuffle_ps(_mm_castsi128_ps(first), _mm_castsi128_ps(second), _MM_SHUFFLE(2, 0, 2, 0));
+			const __m128 odd = _mm_shuffle_ps(_mm_castsi128_ps(first), _mm_castsi128_ps(second), _MM_SHUFFLE(3, 1, 3, 1));
+			_mm_storeu_si128(
+				reinterpret_cast<__m128i *>(out + done),
+				_mm_avg_epu8(_mm_castps_si128(even), _mm_castps_si128(odd)));
+		}
+#endif
+		downsample_scalar(upper + done * 8, lower + done * 8, width - done, reinterpret_cast<uint8_t *>(out + done));
+	}
+}
+
+
+
+TerminalOutput::TerminalOutput(
+	const raii::Device &_device,
+	const raii::PhysicalDevice &physical_device,
+	const vk::PhysicalDeviceMemoryProperties &memory_properties,
+	const vk::Format source_format,
+	const vk::Extent2D source_extent,
+	const Mode _mode,
+	const float max_fps
+):
+	device(_device),
+	mode(_mode),
+	readback_format(readback_format_for(source_format)),
+	interval(std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<float>(1.0f / max_fps)))
+{
+	constexpr vk::FormatFeatureFlags blit_features = vk::FormatFeatureFlagBits::eBlitDst;
+	if ((physical_device.getFormatProperties(readback_format).optimalTilingFeatures & blit_features) != blit_features) {
+		throw std::runtime_error("No blits to " + to_string(readback_format) + " for the terminal output");
+	}
+
+	// Leaves a line for the status and one for the cursor
+	winsize terminal{};
+	if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &terminal) != 0 || !terminal.ws_col || terminal.ws_row < 4) {
+		terminal.ws_col = 80;
+		terminal.ws_row = 24;
+	}
+	const unsigned long max_columns = terminal.ws_col;
+	const unsigned long max_pixel_rows = 2 * (terminal.ws_row - 2ul);
+
+	// Half blocks are about square, so pixels keep the frame's aspect ratio
+	const double aspect = static_cast<double>(source_extent.width) / static_cast<double>(source_extent.height);
+	columns = std::min(max_columns, static_cast<unsigned long>(std::lround(static_cast<double>(max_pixel_rows) * aspect)));
+	pixel_rows = std::min(max_pixel_rows, static_cast<unsigned long>(std::lround(static_cast<double>(columns) / aspect)));
+	columns = std::max(columns, 1ul);
+	pixel_rows = std::max(pixel_rows & ~1ul, 2ul);
+	readback_extent = vk::Extent2D{static_cast<uint32_t>(2 * columns), static_cast<uint32_t>(2 * pixel_rows)};
+
+	board = BlackBoard{columns, pixel_rows / 2 + 1};
+	pixels.resize(columns * pixel_rows);
+
+	// Cached memory makes the CPU's reads fast, it only needs to be invalidated if it is not coherent as well
+	constexpr vk::MemoryPropertyFlags visible = vk::MemoryPropertyFlagBits::eHostVisible;
+	constexpr vk::MemoryPropertyFlags cached = vk::MemoryPropertyFlagBits::eHostCached;
+	constexpr vk::MemoryPropertyFlags host_coherent = vk::MemoryPropertyFlagBits::eHostCoherent;
+
+	const vk::BufferCreateInfo buffer_create_info = {
+		{},
+		buffer_size(),
+		vk::BufferUsageFlagBits::eTransferDst,
+		vk::SharingMode::eExclusive
+	};
+
+	for (Slot &slot : slots) {
+		slot.buffer = raii::Buffer{device, buffer_create_info};
+		const vk::MemoryRequirements requirements = slot.buffer.getMemoryRequirements();
+
+		std::optional<uint32_t> memory_type;
+		for (const vk::MemoryPropertyFlags wanted : {visible | cached | host_coherent, visible | cached, visible | host_coherent}) {
+			for (uint32_t type = 0; type < memory_properties.memoryTypeCount && !memory_type; ++type) {
+				if (!(requirements.memoryTypeBits & 1u << type)) continue;
+				if ((memory_properties.memoryTypes[type].propertyFlags & wanted) == wanted) memory_type = type;
+			}
+			if (memory_type) break;
+		}
+		if (!memory_type) throw std::runtime_error("No host visible memory for the terminal readback");
+		coherent = static_cast<bool>(memory_properties.memoryTypes[*memory_type].propertyFlags & host_coherent);
+
+		slot.memory = raii::DeviceMemory{device, vk::MemoryAllocateInfo{requirements.size, *memory_type}};
+		slot.buffer.bindMemory(*slot.memory, 0);
+		slot.mapped = static_cast<const uint8_t *>(slot.memory.mapMemory(0, buffer_create_info.size));
+	}
+
+	worker = std::jthread{[this](const std::stop_token &stop) {
+		trace::name_thread("Terminal");
+		draw(stop);
+	}};
+}
+
+TerminalOutput::Mode TerminalOutput::detect_mode() {
+	const char *color_term = std::getenv("COLORTERM");
+	if (!color_term) return Mode::Ascii;
+	const std::string_view value = color_term;
+	return value == "truecolor" || value == "24bit" ? Mode::HalfBlock : Mode::Ascii;
+}
+
+vk::Extent2D TerminalOutput::cells() const {
+	return {static_cast<uint32_t>(columns), static_cast<uint32_t>(pixel_rows / 2)};
+}
+
+vk::DeviceSize TerminalOutput::buffer_size() const {
+	return static_cast<vk::DeviceSize>(readback_extent.width) * readback_extent.height * 4;
+}
+
+void TerminalOutput::add_passes(
+	RenderGraph &graph,
+	const RenderGraph::Resource color,
+	const vk::Extent2D source_extent,
+	const uint64_t frame
+) {
+	// The passes are declared every frame, so the graph's transient images stay the same, but only record
+	// anything when a readback is due and a buffer is free
+	std::optional<uint32_t> index;
+	if (const auto now = std::chrono::steady_clock::now(); now >= next_readback) {
+		std::lock_guard lock{mutex};
+		if (const auto free = std::ranges::find(slots, Slot::Free, &Slot::state); free != slots.end()) {
+			free->state = Slot::Pending;
+			free->frame = frame;
+			index = static_cast<uint32_t>(free - slots.begin());
+
+			next_readback += interval;
+			if (next_readback < now) next_readback = now + interval;
+		}
+	}
+
+	const RenderGraph::Resource small = graph.create_image("terminal", {
+		readback_format,
+		readback_extent,
+		vk::ImageAspectFlagBits::eColor
+	});
+
+	RenderGraph::Pass &downscale = graph.add_pass("terminal downscale")
+		.read(color, RenderGraph::Usage::TransferSource)
+		.write(small, RenderGraph::Usage::TransferDestination);
+	if (index) {
+		downscale.execute([this, &graph, color, small, source_extent](const raii::CommandBuffer &cmd) {
+			const vk::ImageSubresourceLayers layers = {vk::ImageAspectFlagBits::eColor, 0, 0, 1};
+			const vk::ImageBlit2 region = {
+				layers,
+				{vk::Offset3D{0, 0, 0}, corner(source_extent)},
+				layers,
+				{vk::Offset3D{0, 0, 0}, corner(readback_extent)}
+			};
+			const vk::BlitImageInfo2 blit_info = {
+				graph.image(color),
+				vk::ImageLayout::eTransferSrcOptimal,
+				graph.image(small),
+				vk::ImageLayout::eTransferDstOptimal,
+				1,
+				&region,
+				vk::Filter::eLinear
+			};
+			cmd.blitImage2(blit_info);
+		});
+	}
+
+	// The buffer leaves the graph, so nothing downstream keeps this pass alive
+	RenderGraph::Pass &readback = graph.add_pass("terminal readback")
+		.read(small, RenderGraph::Usage::TransferSource)
+		.keep();
+	if (index) {
+		readback.execute([this, &graph, small, buffer = *slots[*index].buffer](const raii::CommandBuffer &cmd) {
+			const vk::BufferImageCopy region = {
+				0,
+				0,
+				0,
+				{vk::ImageAspectFlagBits::eColor, 0, 0, 1},
+				{0, 0, 0},
+				{readback_extent.width, readback_extent.height, 1}
+			};
+			cmd.copyImageToBuffer(graph.image(small), vk::ImageLayout::eTransferSrcOptimal, buffer, region);
+
+			// Makes the copy visible to the host once the frame's fence has signalled
+			const vk::BufferMemoryBarrier2 to_host = {
+				vk::PipelineStageFlagBits2::eCopy,
+				vk::AccessFlagBits2::eTransferWrite,
+				vk::PipelineStageFlagBits2::eHost,
+				vk::AccessFlagBits2::eHostRead,
+				vk::QueueFamilyIgnored,
+				vk::QueueFamilyIgnored,
+				buffer,
+				0,
+				vk::WholeSize
+			};
+			const vk::DependencyInfo dependency_info = {
+				{},
+				0,
+				nullptr,
+				1,
+				&to_host,
+				0,
+				nullptr
+			};
+			cmd.pipelineBarrier2(dependency_info);
+		});
+	}
+}
+
+void TerminalOutput::collect(const uint64_t completed_frame) {
+	{
+		std::lock_guard lock{mutex};
+		if (error) std::rethrow_exception(std::exchange(error, nullptr));
+
+		// Only the newest finished frame is worth drawing
+		Slot *newest = nullptr;
+		for (Slot &slot : slots) {
+			if (slot.state != Slot::Pending || slot.frame > completed_frame) continue;
+			if (newest && newest->frame > slot.frame) {
+				slot.state = Slot::Free;
+				continue;
+			}
+			if (newest) newest->state = Slot::Free;
+			newest = &slot;
+		}
+		if (!newest) return;
+
+		if (!coherent) device.invalidateMappedMemoryRanges(vk::MappedMemoryRange{*newest->memory, 0, vk::WholeSize});
+		if (ready) slots[*ready].state = Slot::Free;
+		newest->state = Slot::Ready;
+		ready = static_cast<uint32_t>(newest - slots.data());
+	}
+	slot_ready.notify_one();
+}
+
+void TerminalOutput::set_status(std::string line) {
+	std::lock_guard lock{mutex};
+	status = std::move(line);
+}
+
+void TerminalOutput::draw(const std::stop_token &stop) {
+	std::string status_line;
+
+	while (true) {
+		uint32_t index;
+		{
+			std::unique_lock lock{mutex};
+			if (!slot_ready.wait(lock, stop, [this] { return ready.has_value(); })) return;
+			index = *ready;
+			ready.reset();
+			slots[index].state = Slot::Converting;
+			status_line = status;
+		}
+
+		// The buffer is free again as soon as it is filtered, the GPU can fill it while the terminal catches up
+		TRACE_ZONE("terminal frame");
+		downsample_2x2(slots[index].mapped, static_cast<uint32_t>(columns), static_cast<uint32_t>(pixel_rows), pixels.data());
+		{
+			std::lock_guard lock{mutex};
+			slots[index].state = Slot::Free;
+		}
+
+		draw_cells();
+		board.write({pixel_rows / 2, 0}, status_line, BlackBoard::DIM);
+
+		try {
+			board.flush();
+		} catch (...) {
+			std::lock_guard lock{mutex};
+			error = std::current_exception();
+			return;
+		}
+	}
+}
+
+void TerminalOutput::draw_cells() {
+	for (unsigned long x = 0; x < pixel_rows / 2; x++) {
+		const uint32_t *upper = pixels.data() + 2 * x * columns;
+		const uint32_t *lower = upper + columns;
+		const std::span<char32_t> characters = board.row(x);
+
+		if (mode == Mode::HalfBlock) {
+			const std::span<uint32_t> foregrounds = board.row_foregrounds(x);
+			const std::span<uint32_t> backgrounds = board.row_backgrounds(x);
+			std::ranges::fill(characters, U'▀');
+			for (unsigned long y = 0; y < columns; y++) {
+				foregrounds[y] = board_color(upper[y]);
+				backgrounds[y] = board_color(lower[y]);
+			}
+		} else {
+			for (unsigned long y = 0; y < columns; y++) {
+				const uint32_t level = (luminance(upper[y]) + luminance(lower[y])) / 2;
+				characters[y] = LUMINANCE_RAMP[level * LUMINANCE_RAMP.size() / 256];
+			}
+		}
+	}
+}
@@ -0,0 +1,108 @@
+#pragma once
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <vulkan/vulkan_raii.hpp>
+
+#include "BlackBoard.h"
+#include "RenderGraph.h"
+
+namespace raii = vk::raii;
+
+// Shows the rendered frames in the terminal, for instances running without anyone looking at their window.
+// The graph blits the frame down to twice the cell resolution and copies it into one of a few persistently mapped
+// buffers. Once the frame's fence has passed, a thread of its own averages every 2x2 block, maps the result to cells
+// and draws them through a BlackBoard, whose diffing flush only sends the cells that changed.
+// The render loop never waits on any of it: frames are skipped while every buffer is busy or the terminal is slow.
+class TerminalOutput {
+public:
+	enum class Mode {
+		HalfBlock, // '▀' with the upper pixel as foreground and the lower as background color, needs truecolor
+		Ascii,     // A character ramp by the luminance of both pixels
+	};
+
+private:
+	struct Slot {
+		enum State {
+			Free,
+			Pending,   // Copy recorded, the GPU may still write to it
+			Ready,     // Waiting for the drawing thread
+			Converting,
+		};
+
+		raii::DeviceMemory memory{nullptr};
+		raii::Buffer buffer{nullptr};
+		const uint8_t *mapped = nullptr;
+		State state = Free;
+		uint64_t frame = 0;
+	};
+
+	const raii::Device &device;
+	Mode mode;
+	vk::Format readback_format;
+	vk::Extent2D readback_extent; // Twice the pixels in both directions
+	unsigned long columns;
+	unsigned long pixel_rows;     // Two per row of cells
+	bool coherent = false;
+	std::chrono::steady_clock::duration interval;
+	std::chrono::steady_clock::time_point next_readback;
+
+	// Slot states, ready and status are shared with the drawing thread
+	std::mutex mutex;
+	std::condition_variable_any slot_ready;
+	std::array<Slot, 3> slots;
+	std::optional<uint32_t> ready;
+	std::string status;
+	std::exception_ptr error;
+
+	// Only touched by the drawing thread
+	BlackBoard board;
+	std::vector<uint32_t> pixels;
+
+	std::jthread worker; // Last, so it stops before anything it uses goes away
+
+	void draw(const std::stop_token &stop);
+	void draw_cells();
+
+public:
+	// source_format: the format of the images handed to add_passes(), which need to support blits from them
+	TerminalOutput(
+		const raii::Device &_device,
+		const raii::PhysicalDevice &physical_device,
+		const vk::PhysicalDeviceMemoryProperties &memory_properties,
+		vk::Format source_format,
+		vk::Extent2D source_extent,
+		Mode _mode,
+		float max_fps = 30.0f);
+	TerminalOutput(const TerminalOutput &) = delete;
+	TerminalOutput &operator=(const TerminalOutput &) = delete;
+
+	// Reads back the top left source_extent of color, unless the last readback is too recent or no buffer is free.
+	// Call it for every frame. frame numbers the submissions, collect() takes the last one whose fence has passed.
+	void add_passes(RenderGraph &graph, RenderGraph::Resource color, vk::Extent2D source_extent, uint64_t frame);
+	// Hands the newest finished readback to the drawing thread, dropping one it has not started on yet.
+	// Rethrows what stopped the drawing thread.
+	void collect(uint64_t completed_frame);
+	// Printed below the picture
+	void set_status(std::string line);
+
+	[[nodiscard]] Mode current_mode() const { return mode; }
+	[[nodiscard]] vk::Extent2D cells() const;
+	[[nodiscard]] vk::DeviceSize buffer_size() const;
+	[[nodiscard]] bool host_coherent() const { return coherent; }
+
+	// HalfBlock if COLORTERM says the terminal takes truecolor escapes
+	[[nodiscard]] static Mode detect_mode();
+};
+
+// 2x2 box filter over RGBA8 pixels: each of the width x height output pixels averages a block of the source, which is
+// twice as wide and high. Rounds like _mm_avg_epu8, vertically first.
+void downsample_2x2(const uint8_t *source, uint32_t width, uint32_t height, uint32_t *destination);
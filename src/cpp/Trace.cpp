@@ -0,0 +1,140 @@
+#include "Trace.h"
+
+#include <cstdio>
+#include <fstream>
+#include <mutex>
+#include <set>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+	std::mutex tracks_mutex;
+	std::vector<std::unique_ptr<trace::Track>> tracks;
+	std::atomic<trace::Time> session_begin = 0;
+
+	void append_escaped(std::string &out, const std::string_view text) {
+		for (const char c : text) {
+			if (c == '"' || c == '\\') {
+				out += '\\';
+				out += c;
+			} else if (static_cast<unsigned char>(c) < 0x20) {
+				char escaped[8];
+				std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+				out += escaped;
+			} else {
+				out += c;
+			}
+		}
+	}
+
+	void append_metadata(std::string &out, const char *name, const uint32_t tid, const std::string_view value) {
+		out += R"({"ph":"M","pid":1,"tid":)";
+		out += std::to_string(tid);
+		out += R"(,"name":")";
+		out += name;
+		out += R"(","args":{"name":")";
+		append_escaped(out, value);
+		out += "\"}},\n";
+	}
+}
+
+trace::Track::Track(std::string _name, const uint32_t _id)
+	: name(std::move(_name)), id(_id) {}
+
+void trace::Track::rename(std::string _name) {
+	const std::lock_guard lock(tracks_mutex);
+	name = std::move(_name);
+}
+
+void trace::start() {
+	session_begin.store(now(), std::memory_order_relaxed);
+	detail::on.store(true, std::memory_order_relaxed);
+}
+
+void trace::stop() {
+	detail::on.store(false, std::memory_order_relaxed);
+}
+
+trace::Track &trace::thread_track() {
+	thread_local Track *track = nullptr;
+	if (!track) track = &create_track({});
+	return *track;
+}
+
+void trace::name_thread(std::string name) {
+	thread_track().rename(std::move(name));
+}
+
+trace::Track &trace::create_track(std::string name) {
+	const std::lock_guard lock(tracks_mutex);
+	const auto id = static_cast<uint32_t>(tracks.size());
+	if (name.empty()) name = "Thread " + std::to_string(id);
+	return *tracks.emplace_back(std::make_unique<Track>(std::move(name), id));
+}
+
+const char *trace::intern(const std::string_view name) {
+	static std::mutex mutex;
+	static std::set<std::string, std::less<>> names;
+	const std::lock_guard lock(mutex);
+	auto found = names.find(name);
+	if (found == names.end()) found = names.emplace(name).first;
+	return found->c_str();
+}
+
+size_t trace::write(const std::string &path) {
+	const Time origin = session_begin.load(std::memory_order_relaxed);
+	size_t count = 0;
+	std::string out = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+	std::vector<Event> copied;
+
+	{
+		const std::lock_guard lock(tracks_mutex);
+		append_metadata(out, "process_name", 0, "LavaChicken");
+		for (const std::unique_ptr<Track> &track : tracks) {
+			const uint64_t head = track->head.load(std::memory_order_acquire);
+			const uint64_t first = head > Track::CAPACITY ? head - Track::CAPACITY : 0;
+			copied.clear();
+			for (uint64_t i = first; i < head; i++) {
+				// The owner may be writing a later event into the slot, then the copy is dropped
+				const Track::Slot &slot = track->slots[i & (Track::CAPACITY - 1)];
+				const uint64_t sequence = slot.sequence.load(std::memory_order_acquire);
+				const Event event = {
+					slot.name.load(std::memory_order_relaxed),
+					slot.begin.load(std::memory_order_relaxed),
+					slot.end.load(std::memory_order_relaxed)
+				};
+				std::atomic_thread_fence(std::memory_order_acquire);
+				if (sequence != 2 * i + 2 || slot.sequence.load(std::memory_order_relaxed) != sequence) continue;
+				copied.push_back(event);
+			}
+
+			append_metadata(out, "thread_name", track->id, track->name);
+			for (const Event &event : copied) {
+				if (event.begin < origin) continue;
+
+				char timing[96];
+				std::snprintf(
+					timing,
+					sizeof(timing),
+					R"(","ts":%.3f,"dur":%.3f,"pid":1,"tid":%u},)",
+					static_cast<double>(event.begin - origin) / 1000.0,
+					static_cast<double>(event.end - event.begin) / 1000.0,
+					track->id);
+				out += R"({"ph":"X","name":")";
+				append_escaped(out, event.name);
+				out += timing;
+				out += '\n';
+				count++;
+			}
+		}
+	}
+
+	out.resize(out.size() - 2); // The last ",\n", there is always the process name before it
+	out += "\n]}\n";
+
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	if (!file.write(out.data(), static_cast<std::streamsize>(out.size()))) {
+		throw std::runtime_error("Failed to write trace " + path);
+	}
+	return count;
+}
@@ -0,0 +1,114 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+
+// Timeline of what the threads were doing, written as Chrome trace JSON (chrome://tracing, ui.perfetto.dev).
+// TRACE_ZONE("name") records the rest of the enclosing scope as a zone of the calling thread. Each thread records
+// into a ring buffer of its own without locks, so only the last Track::CAPACITY zones of a thread make it into a
+// trace. While tracing is off a zone costs one relaxed load and a branch.
+namespace trace {
+	// Nanoseconds of std::chrono::steady_clock, which is CLOCK_MONOTONIC on Linux
+	using Time = int64_t;
+
+	struct Event {
+		const char *name; // Has to outlive the trace, a literal or a name the recording side keeps
+		Time begin;
+		Time end;
+	};
+
+	// Zones of one thread, or of something else with a timeline of its own like a GPU queue.
+	// Only a single thread may record into a track.
+	class Track {
+		friend size_t write(const std::string &path);
+
+	public:
+		static constexpr size_t CAPACITY = 1 << 15; // A power of two
+
+	private:
+		// A seqlock per slot: sequence is odd while the owner writes event i into it and 2i + 2 once it is done,
+		// so write() can tell whether what it copied is event i whole
+		struct Slot {
+			std::atomic<uint64_t> sequence;
+			std::atomic<const char *> name;
+			std::atomic<Time> begin;
+			std::atomic<Time> end;
+		};
+
+		std::string name;
+		uint32_t id;
+		// Allocated by the first record(), so tracks of threads that never record while tracing is on cost no more
+		// than their name. Other threads only look at it once head is past 0.
+		std::unique_ptr<Slot[]> slots;
+		std::atomic<uint64_t> head = 0; // Events recorded so far, the last CAPACITY of them are kept
+
+	public:
+		Track(std::string _name, uint32_t _id);
+
+		void record(const char *event_name, const Time begin, const Time end) {
+			const uint64_t position = head.load(std::memory_order_relaxed);
+			if (!slots) [[unlikely]] slots = std::make_unique<Slot[]>(CAPACITY);
+			Slot &slot = slots[position & (CAPACITY - 1)];
+			slot.sequence.store(2 * position + 1, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_release);
+			slot.name.store(event_name, std::memory_order_relaxed);
+			slot.begin.store(begin, std::memory_order_relaxed);
+			slot.end.store(end, std::memory_order_relaxed);
+			slot.sequence.store(2 * position + 2, std::memory_order_release);
+			head.store(position + 1, std::memory_order_release);
+		}
+
+		void rename(std::string _name);
+	};
+
+	namespace detail {
+		inline std::atomic<bool> on = false;
+	}
+
+	[[nodiscard]] inline bool enabled() { return detail::on.load(std::memory_order_relaxed); }
+
+	[[nodiscard]] inline Time now() {
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	// Zones recorded before start() are left out of the next trace
+	void start();
+	void stop();
+
+	// The calling thread's track, created the first time
+	[[nodiscard]] Track &thread_track();
+	// Also creates the thread's track, so threads show up by name even before their first zone
+	void name_thread(std::string name);
+	// A track that is not a thread's, lives as long as the program. Unnamed ones are numbered.
+	[[nodiscard]] Track &create_track(std::string name);
+
+	// A copy of the name that lives as long as the program, for zone names that are not literals
+	[[nodiscard]] const char *intern(std::string_view name);
+
+	// Writes the zones since start() of every track, returns their number. Throws if the file cannot be written.
+	// Zones a thread records while this runs may be left out, along with the ones they overwrite.
+	size_t write(const std::string &path);
+
+	class Zone {
+		const char *name;
+		Time begin = -1;
+
+	public:
+		explicit Zone(const char *_name) : name(_name) {
+			if (enabled()) begin = now();
+		}
+		Zone(const Zone &) = delete;
+		Zone &operator=(const Zone &) = delete;
+		~Zone() {
+			if (begin >= 0) thread_track().record(name, begin, now());
+		}
+	};
+}
+
+#define TRACE_CONCATENATE_(a, b) a##b
+#define TRACE_CONCATENATE(a, b) TRACE_CONCATENATE_(a, b)
+#define TRACE_ZONE(name) const trace::Zone TRACE_CONCATENATE(trace_zone_, __LINE__){name}
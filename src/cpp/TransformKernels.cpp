@@ -0,0 +1,71 @@
+#include "TransformKernels.inl"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <emmintrin.h>
+
+namespace {
+	// SSE2 is part of x86-64, so this unit needs no extra target flags
+	struct Sse2Lanes {
+		using T = __m128;
+		static constexpr uint32_t WIDTH = 4;
+
+		static T load(const float *source) { return _mm_loadu_ps(source); }
+		static void store(float *destination, const T value) { _mm_storeu_ps(destination, value); }
+		static T gather(const float *base, const int32_t *indices) {
+			return _mm_setr_ps(base[indices[0]], base[indices[1]], base[indices[2]], base[indices[3]]);
+		}
+		static T set(const float value) { return _mm_set1_ps(value); }
+		static T add(const T a, const T b) { return _mm_add_ps(a, b); }
+		static T sub(const T a, const T b) { return _mm_sub_ps(a, b); }
+		static T mul(const T a, const T b) { return _mm_mul_ps(a, b); }
+		static T mul_add(const T a, const T b, const T c) { return _mm_add_ps(_mm_mul_ps(a, b), c); }
+		static T abs(const T a) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a); }
+		static T sqrt(const T a) { return _mm_sqrt_ps(a); }
+	};
+}
+
+void transform_kernels::update_sse2(const Streams &streams, const uint32_t begin, const uint32_t end) {
+	const uint32_t done = update_range<Sse2Lanes>(streams, begin, end);
+	update_range<ScalarLanes>(streams, done, end);
+}
+#endif
+
+void transform_kernels::update_scalar(const Streams &streams, const uint32_t begin, const uint32_t end) {
+	update_range<ScalarLanes>(streams, begin, end);
+}
+
+bool transform_kernels::supported(const Isa isa) {
+	switch (isa) {
+#if defined(__x86_64__) || defined(__i386__)
+		case Isa::Avx2: return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+		case Isa::Sse2: return __builtin_cpu_supports("sse2");
+#endif
+		case Isa::Scalar: return true;
+		default: return false;
+	}
+}
+
+transform_kernels::Isa transform_kernels::best_isa() {
+	if (supported(Isa::Avx2)) return Isa::Avx2;
+	if (supported(Isa::Sse2)) return Isa::Sse2;
+	return Isa::Scalar;
+}
+
+const char *transform_kernels::name(const Isa isa) {
+	switch (isa) {
+		case Isa::Avx2: return "AVX2";
+		case Isa::Sse2: return "SSE2";
+		default: return "scalar";
+	}
+}
+
+transform_kernels::Kernel transform_kernels::kernel(const Isa isa) {
+	if (!supported(isa)) return update_scalar;
+	switch (isa) {
+#if defined(__x86_64__) || defined(__i386__)
+		case Isa::Avx2: return update_avx2;
+		case Isa::Sse2: return update_sse2;
+#endif
+		default: return update_scalar;
+	}
+}
@@ -0,0 +1,54 @@
+#pragma once
+#include <cstdint>
+
+// Kernels behind SceneTransforms. Every field is its own float array (structure of arrays), one element per node,
+// so the kernels process several nodes per instruction. Each node's parent lies in an earlier range, which lets a
+// whole range be updated at once.
+namespace transform_kernels {
+	enum Field : uint32_t {
+		// Inputs, relative to the parent
+		LOCAL_POSITION_X, LOCAL_POSITION_Y, LOCAL_POSITION_Z,
+		LOCAL_ROTATION_X, LOCAL_ROTATION_Y, LOCAL_ROTATION_Z, LOCAL_ROTATION_W,
+		LOCAL_SCALE,
+		BOUNDS_CENTER_X, BOUNDS_CENTER_Y, BOUNDS_CENTER_Z, // Local space box
+		BOUNDS_EXTENT_X, BOUNDS_EXTENT_Y, BOUNDS_EXTENT_Z, // Half size
+
+		// Outputs
+		WORLD_POSITION_X, WORLD_POSITION_Y, WORLD_POSITION_Z,
+		WORLD_ROTATION_X, WORLD_ROTATION_Y, WORLD_ROTATION_Z, WORLD_ROTATION_W,
+		WORLD_SCALE,
+		MATRIX_00, MATRIX_01, MATRIX_02, MATRIX_03, // Affine world matrix, row-major 3x4
+		MATRIX_10, MATRIX_11, MATRIX_12, MATRIX_13,
+		MATRIX_20, MATRIX_21, MATRIX_22, MATRIX_23,
+		AABB_MIN_X, AABB_MIN_Y, AABB_MIN_Z,
+		AABB_MAX_X, AABB_MAX_Y, AABB_MAX_Z,
+		SPHERE_X, SPHERE_Y, SPHERE_Z, SPHERE_RADIUS,
+
+		FIELD_COUNT
+	};
+
+	struct Streams {
+		float *fields[FIELD_COUNT];
+		const int32_t *parents; // Index of each node's parent
+	};
+
+	enum class Isa {
+		Scalar,
+		Sse2,
+		Avx2, // With FMA
+	};
+
+	// Updates the outputs of nodes [begin, end) from their inputs and their parents' outputs
+	using Kernel = void (*)(const Streams &streams, uint32_t begin, uint32_t end);
+
+	[[nodiscard]] Isa best_isa();
+	[[nodiscard]] bool supported(Isa isa);
+	[[nodiscard]] const char *name(Isa isa);
+	[[nodiscard]] Kernel kernel(Isa isa);
+
+	void update_scalar(const Streams &streams, uint32_t begin, uint32_t end);
+#if defined(__x86_64__) || defined(__i386__)
+	void update_sse2(const Streams &streams, uint32_t begin, uint32_t end);
+	void update_avx2(const Streams &streams, uint32_t begin, uint32_t end); // TransformKernelsAvx2.cpp
+#endif
+}
@@ -0,0 +1,144 @@
+#pragma once
+#include "TransformKernels.h"
+
+// The kernel body shared by every instruction set, written once against a lane type V that supplies WIDTH, the
+// vector type T and the arithmetic. Everything here has internal linkage: each translation unit is built with
+// different target flags, and the linker must not pick one unit's copy for another.
+// Only compiler builtins and intrinsics are used, no standard library or glm headers, for the same reason.
+namespace {
+	using namespace transform_kernels;
+
+	struct ScalarLanes {
+		using T = float;
+		static constexpr uint32_t WIDTH = 1;
+
+		static T load(const float *source) { return *source; }
+		static void store(float *destination, const T value) { *destination = value; }
+		static T gather(const float *base, const int32_t *indices) { return base[*indices]; }
+		static T set(const float value) { return value; }
+		static T add(const T a, const T b) { return a + b; }
+		static T sub(const T a, const T b) { return a - b; }
+		static T mul(const T a, const T b) { return a * b; }
+		static T mul_add(const T a, const T b, const T c) { return a * b + c; }
+		static T abs(const T a) { return __builtin_fabsf(a); }
+		static T sqrt(const T a) { return __builtin_sqrtf(a); }
+	};
+
+	// Processes whole groups of V::WIDTH nodes starting at begin, returns where it stopped
+	template<typename V>
+	uint32_t update_range(const Streams &streams, const uint32_t begin, const uint32_t end) {
+		using T = typename V::T;
+		float *const *const field = streams.fields;
+		const T one = V::set(1.0f);
+		const T two = V::set(2.0f);
+
+		uint32_t i = begin;
+		for (; end - i >= V::WIDTH; i += V::WIDTH) {
+			const int32_t *parents = streams.parents + i;
+
+			// The parent's world transform, already final since parents come in earlier ranges
+			const T parent_x = V::gather(field[WORLD_POSITION_X], parents);
+			const T parent_y = V::gather(field[WORLD_POSITION_Y], parents);
+			const T parent_z = V::gather(field[WORLD_POSITION_Z], parents);
+			const T parent_qx = V::gather(field[WORLD_ROTATION_X], parents);
+			const T parent_qy = V::gather(field[WORLD_ROTATION_Y], parents);
+			const T parent_qz = V::gather(field[WORLD_ROTATION_Z], parents);
+			const T parent_qw = V::gather(field[WORLD_ROTATION_W], parents);
+			const T parent_scale = V::gather(field[WORLD_SCALE], parents);
+
+			const T local_qx = V::load(field[LOCAL_ROTATION_X] + i);
+			const T local_qy = V::load(field[LOCAL_ROTATION_Y] + i);
+			const T local_qz = V::load(field[LOCAL_ROTATION_Z] + i);
+			const T local_qw = V::load(field[LOCAL_ROTATION_W] + i);
+
+			// Compose as rotation, uniform scale and translation, which is cheaper than a matrix product
+			const T qw = V::sub(V::sub(V::sub(
+				V::mul(parent_qw, local_qw), V::mul(parent_qx, local_qx)), V::mul(parent_qy, local_qy)), V::mul(parent_qz, local_qz));
+			const T qx = V::sub(V::add(V::add(
+				V::mul(parent_qw, local_qx), V::mul(parent_qx, local_qw)), V::mul(parent_qy, local_qz)), V::mul(parent_qz, local_qy));
+			const T qy = V::add(V::add(V::sub(
+				V::mul(parent_qw, local_qy), V::mul(parent_qx, local_qz)), V::mul(parent_qy, local_qw)), V::mul(parent_qz, local_qx));
+			const T qz = V::add(V::sub(V::add(
+				V::mul(parent_qw, local_qz), V::mul(parent_qx, local_qy)), V::mul(parent_qy, local_qx)), V::mul(parent_qz, local_qw));
+			const T scale = V::mul(parent_scale, V::load(field[LOCAL_SCALE] + i));
+
+			// Local position scaled and rotated into the parent: v + 2 * cross(q, cross(q, v) + w * v)
+			const T vx = V::mul(parent_scale, V::load(field[LOCAL_POSITION_X] + i));
+			const T vy = V::mul(parent_scale, V::load(field[LOCAL_POSITION_Y] + i));
+			const T vz = V::mul(parent_scale, V::load(field[LOCAL_POSITION_Z] + i));
+			const T tx = V::mul_add(parent_qw, vx, V::sub(V::mul(parent_qy, vz), V::mul(parent_qz, vy)));
+			const T ty = V::mul_add(parent_qw, vy, V::sub(V::mul(parent_qz, vx), V::mul(parent_qx, vz)));
+			const T tz = V::mul_add(parent_qw, vz, V::sub(V::mul(parent_qx, vy), V::mul(parent_qy, vx)));
+			const T x = V::add(parent_x, V::mul_add(two, V::sub(V::mul(parent_qy, tz), V::mul(parent_qz, ty)), vx));
+			const T y = V::add(parent_y, V::mul_add(two, V::sub(V::mul(parent_qz, tx), V::mul(parent_qx, tz)), vy));
+			const T z = V::add(parent_z, V::mul_add(two, V::sub(V::mul(parent_qx, ty), V::mul(parent_qy, tx)), vz));
+
+			V::store(field[WORLD_POSITION_X] + i, x);
+			V::store(field[WORLD_POSITION_Y] + i, y);
+			V::store(field[WORLD_POSITION_Z] + i, z);
+			V::store(field[WORLD_ROTATION_X] + i, qx);
+			V::store(field[WORLD_ROTATION_Y] + i, qy);
+			V::store(field[WORLD_ROTATION_Z] + i, qz);
+			V::store(field[WORLD_ROTATION_W] + i, qw);
+			V::store(field[WORLD_SCALE] + i, scale);
+
+			// Rotation matrix of the world quaternion, times the scale
+			const T xx = V::mul(qx, qx), yy = V::mul(qy, qy), zz = V::mul(qz, qz);
+			const T xy = V::mul(qx, qy), xz = V::mul(qx, qz), yz = V::mul(qy, qz);
+			const T wx = V::mul(qw, qx), wy = V::mul(qw, qy), wz = V::mul(qw, qz);
+			const T two_scale = V::mul(two, scale);
+			const T m00 = V::mul(scale, V::sub(one, V::mul(two, V::add(yy, zz))));
+			const T m01 = V::mul(two_scale, V::sub(xy, wz));
+			const T m02 = V::mul(two_scale, V::add(xz, wy));
+			const T m10 = V::mul(two_scale, V::add(xy, wz));
+			const T m11 = V::mul(scale, V::sub(one, V::mul(two, V::add(xx, zz))));
+			const T m12 = V::mul(two_scale, V::sub(yz, wx));
+			const T m20 = V::mul(two_scale, V::sub(xz, wy));
+			const T m21 = V::mul(two_scale, V::add(yz, wx));
+			const T m22 = V::mul(scale, V::sub(one, V::mul(two, V::add(xx, yy))));
+
+			V::store(field[MATRIX_00] + i, m00);
+			V::store(field[MATRIX_01] + i, m01);
+			V::store(field[MATRIX_02] + i, m02);
+			V::store(field[MATRIX_03] + i, x);
+			V::store(field[MATRIX_10] + i, m10);
+			V::store(field[MATRIX_11] + i, m11);
+			V::store(field[MATRIX_12] + i, m12);
+			V::store(field[MATRIX_13] + i, y);
+			V::store(field[MATRIX_20] + i, m20);
+			V::store(field[MATRIX_21] + i, m21);
+			V::store(field[MATRIX_22] + i, m22);
+			V::store(field[MATRIX_23] + i, z);
+
+			// The box's center moves with the matrix, its extent along each world axis is |M| times the local extent
+			const T cx = V::load(field[BOUNDS_CENTER_X] + i);
+			const T cy = V::load(field[BOUNDS_CENTER_Y] + i);
+			const T cz = V::load(field[BOUNDS_CENTER_Z] + i);
+			const T ex = V::load(field[BOUNDS_EXTENT_X] + i);
+			const T ey = V::load(field[BOUNDS_EXTENT_Y] + i);
+			const T ez = V::load(field[BOUNDS_EXTENT_Z] + i);
+
+			const T center_x = V::mul_add(m00, cx, V::mul_add(m01, cy, V::mul_add(m02, cz, x)));
+			const T center_y = V::mul_add(m10, cx, V::mul_add(m11, cy, V::mul_add(m12, cz, y)));
+			const T center_z = V::mul_add(m20, cx, V::mul_add(m21, cy, V::mul_add(m22, cz, z)));
+			const T extent_x = V::mul_add(V::abs(m00), ex, V::mul_add(V::abs(m01), ey, V::mul(V::abs(m02), ez)));
+			const T extent_y = V::mul_add(V::abs(m10), ex, V::mul_add(V::abs(m11), ey, V::mul(V::abs(m12), ez)));
+			const T extent_z = V::mul_add(V::abs(m20), ex, V::mul_add(V::abs(m21), ey, V::mul(V::abs(m22), ez)));
+
+			V::store(field[AABB_MIN_X] + i, V::sub(center_x, extent_x));
+			V::store(field[AABB_MIN_Y] + i, V::sub(center_y, extent_y));
+			V::store(field[AABB_MIN_Z] + i, V::sub(center_z, extent_z));
+			V::store(field[AABB_MAX_X] + i, V::add(center_x, extent_x));
+			V::store(field[AABB_MAX_Y] + i, V::add(center_y, extent_y));
+			V::store(field[AABB_MAX_Z] + i, V::add(center_z, extent_z));
+
+			// Sphere around the local box, rotation does not change its radius
+			const T local_radius = V::sqrt(V::mul_add(ex, ex, V::mul_add(ey, ey, V::mul(ez, ez))));
+			V::store(field[SPHERE_X] + i, center_x);
+			V::store(field[SPHERE_Y] + i, center_y);
+			V::store(field[SPHERE_Z] + i, center_z);
+			V::store(field[SPHERE_RADIUS] + i, V::mul(V::abs(scale), local_radius));
+		}
+		return i;
+	}
+}
@@ -0,0 +1,31 @@
+// Built with AVX2 and FMA enabled (see CMakeLists.txt), only called once the CPU reports support for both
+#include "TransformKernels.inl"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+
+namespace {
+	struct Avx2Lanes {
+		using T = __m256;
+		static constexpr uint32_t WIDTH = 8;
+
+		static T load(const float *source) { return _mm256_loadu_ps(source); }
+		static void store(float *destination, const T value) { _mm256_storeu_ps(destination, value); }
+		static T gather(const float *base, const int32_t *indices) {
+			return _mm256_i32gather_ps(base, _mm256_loadu_si256(reinterpret_cast<const __m256i *>(indices)), 4);
+		}
+		static T set(const float value) { return _mm256_set1_ps(value); }
+		static T add(const T a, const T b) { return _mm256_add_ps(a, b); }
+		static T sub(const T a, const T b) { return _mm256_sub_ps(a, b); }
+		static T mul(const T a, const T b) { return _mm256_mul_ps(a, b); }
+		static T mul_add(const T a, const T b, const T c) { return _mm256_fmadd_ps(a, b, c); }
+		static T abs(const T a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a); }
+		static T sqrt(const T a) { return _mm256_sqrt_ps(a); }
+	};
+}
+
+void transform_kernels::update_avx2(const Streams &streams, const uint32_t begin, const uint32_t end) {
+	const uint32_t done = update_range<Avx2Lanes>(streams, begin, end);
+	update_range<ScalarLanes>(streams, done, end);
+}
+#endif
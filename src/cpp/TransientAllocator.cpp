@@ -0,0 +1,162 @@
+#include "TransientAllocator.h"
+
+#include <algorithm>
+#include <numeric>
+#include <stdexcept>
+
+TransientAllocator::TransientAllocator(const raii::Device &_device, const vk::PhysicalDeviceMemoryProperties &_memory_properties):
+	device(_device),
+	memory_properties(_memory_properties)
+{
+
+}
+
+std::optional<uint32_t> TransientAllocator::memory_type(const uint32_t type_bits, const bool lazy) const {
+	vk::MemoryPropertyFlags required = vk::MemoryPropertyFlagBits::eDeviceLocal;
+	if (lazy) required |= vk::MemoryPropertyFlagBits::eLazilyAllocated;
+
+	for (uint32_t i = 0; i < memory_properties.memoryTypeCount; ++i) {
+		if (!(type_bits & 1u << i)) continue;
+		if ((memory_properties.memoryTypes[i].propertyFlags & required) == required) return i;
+	}
+	return std::nullopt;
+}
+
+const std::vector<TransientAllocator::Allocation> &TransientAllocator::realize(const std::vector<Request> &_requests) {
+	if (_requests == requests && allocations.size() == requests.size()) return allocations;
+
+	allocations.clear();
+	views.clear();
+	images.clear();
+	blocks.clear();
+	requests = _requests;
+	last_report = {};
+	++generation_;
+
+	struct Block {
+		uint32_t memory_type;
+		bool lazy;
+		vk::DeviceSize size = 0;
+		std::vector<Placement> placements;
+	};
+
+	std::vector<vk::MemoryRequirements> requirements;
+	std::vector<Block> placed;
+
+	for (const Request &request : requests) {
+		const vk::ImageCreateInfo create_info = {
+			{},
+			vk::ImageType::e2D,
+			request.format,
+			vk::Extent3D{request.extent.width, request.extent.height, 1},
+			1,
+			1,
+			request.samples,
+			vk::ImageTiling::eOptimal,
+			request.usage,
+			vk::SharingMode::eExclusive,
+			0,
+			nullptr,
+			vk::ImageLayout::eUndefined
+		};
+		images.emplace_back(device, create_info);
+		requirements.push_back(images.back().getMemoryRequirements());
+		last_report.unaliased_bytes += requirements.back().size;
+	}
+
+	// Largest first, each at the lowest offset not overlapping an image that is alive at the same time
+	std::vector<size_t> order(requests.size());
+	std::iota(order.begin(), order.end(), 0);
+	std::stable_sort(order.begin(), order.end(), [&](const size_t a, const size_t b) {
+		return requirements[a].size > requirements[b].size;
+	});
+
+	for (const size_t i : order) {
+		const vk::MemoryRequirements &memory = requirements[i];
+		const bool transient = static_cast<bool>(requests[i].usage & vk::ImageUsageFlagBits::eTransientAttachment);
+
+		std::optional<uint32_t> type = transient ? memory_type(memory.memoryTypeBits, true) : std::nullopt;
+		const bool lazy = type.has_value();
+		if (!type) type = memory_type(memory.memoryTypeBits, false);
+		if (!type) throw std::runtime_error("No device local memory type for a transient image");
+
+		auto block = std::find_if(placed.begin(), placed.end(), [&](const Block &candidate) {
+			return candidate.memory_type == *type;
+		});
+		if (block == placed.end()) block = placed.insert(placed.end(), Block{*type, lazy});
+
+		const auto overlaps_lifetime = [&](const Placement &other) {
+			return requests[other.request].first <= requests[i].last && requests[i].first <= requests[other.request].last;
+		};
+
+		// The lowest fitting offset is either 0 or right behind a conflicting image
+		std::vector<vk::DeviceSize> candidates = {0};
+		for (const Placement &other : block->placements) {
+			if (!overlaps_lifetime(other)) continue;
+			const vk::DeviceSize end = other.offset + other.size;
+			candidates.push_back((end + memory.alignment - 1) / memory.alignment * memory.alignment);
+		}
+		std::sort(candidates.begin(), candidates.end());
+
+		for (const vk::DeviceSize offset : candidates) {
+			const bool fits = std::none_of(block->placements.begin(), block->placements.end(), [&](const Placement &other) {
+				return overlaps_lifetime(other) && offset < other.offset + other.size && other.offset < offset + memory.size;
+			});
+			if (!fits) continue;
+
+			block->placements.push_back({i, offset, memory.size});
+			block->size = std::max(block->size, offset + memory.size);
+			break;
+		}
+	}
+
+	allocations.resize(requests.size());
+
+	for (const Block &block : placed) {
+		blocks.emplace_back(device, vk::MemoryAllocateInfo{block.size, block.memory_type});
+		last_report.allocated_bytes += block.size;
+		if (block.lazy) last_report.lazy_bytes += block.size;
+
+		for (const Placement &placement : block.placements) {
+			images[placement.request].bindMemory(*blocks.back(), placement.offset);
+
+			for (const Placement &other : block.placements) {
+				const bool shares_memory = placement.offset < other.offset + other.size
+					&& other.offset < placement.offset + placement.size;
+				if (shares_memory && requests[other.request].last < requests[placement.request].first) {
+					allocations[placement.request].aliases.push_back(other.request);
+				}
+			}
+		}
+	}
+
+	for (size_t i = 0; i < requests.size(); ++i) {
+		const vk::ImageViewCreateInfo view_create_info = {
+			{},
+			*images[i],
+			vk::ImageViewType::e2D,
+			requests[i].format,
+			vk::ComponentMapping{
+				vk::ComponentSwizzle::eIdentity,
+				vk::ComponentSwizzle::eIdentity,
+				vk::ComponentSwizzle::eIdentity,
+				vk::ComponentSwizzle::eIdentity
+			},
+			vk::ImageSubresourceRange{
+				requests[i].aspect,
+				0,
+				1,
+				0,
+				1
+			}
+		};
+		views.emplace_back(device, view_create_info);
+
+		allocations[i].image = *images[i];
+		allocations[i].view = *views.back();
+	}
+
+	last_report.image_count = requests.size();
+	last_report.block_count = blocks.size();
+	return allocations;
+}
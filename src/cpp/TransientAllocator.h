@@ -0,0 +1,69 @@
+#pragma once
+#include <optional>
+#include <vector>
+
+#include <vulkan/vulkan_raii.hpp>
+
+namespace raii = vk::raii;
+
+// Creates the images that only live within a frame and places those whose lifetimes do not overlap in the same
+// memory. Attachment-only images go to lazily allocated memory where the device has it.
+// Images are kept while the requests stay the same, so a frame has to be finished before the next realize().
+class TransientAllocator {
+public:
+	struct Request {
+		vk::Format format;
+		vk::Extent2D extent;
+		vk::ImageUsageFlags usage;
+		vk::SampleCountFlagBits samples;
+		vk::ImageAspectFlags aspect;
+		size_t first; // First and last step using the image, inclusive
+		size_t last;
+
+		bool operator==(const Request &) const = default;
+	};
+
+	struct Allocation {
+		vk::Image image;
+		vk::ImageView view;
+		std::vector<size_t> aliases; // Earlier requests whose memory this one reuses
+	};
+
+	struct Report {
+		vk::DeviceSize unaliased_bytes = 0; // What one allocation per image would take
+		vk::DeviceSize allocated_bytes = 0;
+		vk::DeviceSize lazy_bytes = 0;      // Part of allocated_bytes which may never be backed
+		size_t image_count = 0;
+		size_t block_count = 0;
+	};
+
+private:
+	struct Placement {
+		size_t request;
+		vk::DeviceSize offset;
+		vk::DeviceSize size;
+	};
+
+	const raii::Device &device;
+	const vk::PhysicalDeviceMemoryProperties &memory_properties; // Filled in by the time anything is realized
+
+	std::vector<Request> requests;
+	std::vector<raii::Image> images;
+	std::vector<raii::ImageView> views;
+	std::vector<raii::DeviceMemory> blocks;
+	std::vector<Allocation> allocations;
+	Report last_report;
+	size_t generation_ = 0;
+
+	[[nodiscard]] std::optional<uint32_t> memory_type(uint32_t type_bits, bool lazy) const;
+
+public:
+	TransientAllocator(const raii::Device &_device, const vk::PhysicalDeviceMemoryProperties &_memory_properties);
+
+	// One allocation per request, in order
+	const std::vector<Allocation> &realize(const std::vector<Request> &_requests);
+
+	[[nodiscard]] const Report &report() const { return last_report; }
+	// Bumped whenever the images are recreated
+	[[nodiscard]] size_t generation() const { return generation_; }
+};
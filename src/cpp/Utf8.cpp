@@ -0,0 +1,156 @@
+#include "Utf8.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <iterator>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace {
+	struct Range {
+		char32_t first;
+		char32_t last;
+	};
+
+	// The common combining marks, variation selectors and zero width characters
+	constexpr Range ZERO_WIDTH[] = {
+		{0x0300, 0x036F}, {0x0483, 0x0489}, {0x0591, 0x05BD}, {0x0610, 0x061A}, {0x064B, 0x065F},
+		{0x0E31, 0x0E31}, {0x0E34, 0x0E3A}, {0x0E47, 0x0E4E}, {0x1AB0, 0x1AFF}, {0x1DC0, 0x1DFF},
+		{0x200B, 0x200F}, {0x202A, 0x202E}, {0x2060, 0x2064}, {0x20D0, 0x20FF}, {0xFE00, 0xFE0F},
+		{0xFE20, 0xFE2F}, {0xFEFF, 0xFEFF}, {0xE0100, 0xE01EF},
+	};
+
+	// East Asian wide and fullwidth characters and emoji presented as such
+	constexpr Range WIDE[] = {
+		{0x1100, 0x115F}, {0x231A, 0x231B}, {0x2329, 0x232A}, {0x23E9, 0x23EC}, {0x23F0, 0x23F0},
+		{0x23F3, 0x23F3}, {0x25FD, 0x25FE}, {0x2614, 0x2615}, {0x2648, 0x2653}, {0x267F, 0x267F},
+		{0x2693, 0x2693}, {0x26A1, 0x26A1}, {0x26AA, 0x26AB}, {0x26BD, 0x26BE}, {0x26C4, 0x26C5},
+		{0x26CE, 0x26CE}, {0x26D4, 0x26D4}, {0x26EA, 0x26EA}, {0x26F2, 0x26F3}, {0x26F5, 0x26F5},
+		{0x26FA, 0x26FA}, {0x26FD, 0x26FD}, {0x2705, 0x2705}, {0x270A, 0x270B}, {0x2728, 0x2728},
+		{0x274C, 0x274C}, {0x274E, 0x274E}, {0x2753, 0x2755}, {0x2757, 0x2757}, {0x2795, 0x2797},
+		{0x27B0, 0x27B0}, {0x27BF, 0x27BF}, {0x2B1B, 0x2B1C}, {0x2B50, 0x2B50}, {0x2B55, 0x2B55},
+		{0x2E80, 0x303E}, {0x3041, 0x33FF}, {0x3400, 0x4DBF}, {0x4E00, 0x9FFF}, {0xA000, 0xA4CF},
+		{0xA960, 0xA97F}, {0xAC00, 0xD7A3}, {0xF900, 0xFAFF}, {0xFE10, 0xFE19}, {0xFE30, 0xFE6F},
+		{0xFF00, 0xFF60}, {0xFFE0, 0xFFE6}, {0x1F004, 0x1F004}, {0x1F0CF, 0x1F0CF}, {0x1F18E, 0x1F18E},
+		{0x1F191, 0x1F19A}, {0x1F200, 0x1F251}, {0x1F300, 0x1F64F}, {0x1F680, 0x1F6FF}, {0x1F900, 0x1F9FF},
+		{0x1FA70, 0x1FAFF}, {0x20000, 0x2FFFD}, {0x30000, 0x3FFFD},
+	};
+
+	template<size_t N>
+	bool contains(const Range (&ranges)[N], const char32_t code_point) {
+		const auto after = std::upper_bound(std::begin(ranges), std::end(ranges), code_point,
+			[](const char32_t value, const Range &range) { return value < range.first; });
+		return after != std::begin(ranges) && code_point <= std::prev(after)->last;
+	}
+
+#ifdef __SSE2__
+	// As signed bytes, continuation bytes (0x80 to 0xBF) are exactly the ones below -64
+	int starts(const __m128i bytes) {
+		return _mm_movemask_epi8(_mm_cmpgt_epi8(bytes, _mm_set1_epi8(-65)));
+	}
+
+	// Leads of sequences for U+0300 and up (0xCC to 0xFF), the first code points that may not be one column wide
+	int wide_leads(const __m128i bytes) {
+		return _mm_movemask_epi8(_mm_and_si128(
+			_mm_cmpgt_epi8(bytes, _mm_set1_epi8(-53)),
+			_mm_cmplt_epi8(bytes, _mm_setzero_si128())));
+	}
+#endif
+
+	bool continuation(const char byte) {
+		return (byte & 0xC0) == 0x80;
+	}
+}
+
+char32_t utf8::decode(const std::string_view text, size_t &offset) {
+	const auto byte = [&](const size_t i) { return static_cast<uint8_t>(text[i]); };
+	const uint8_t lead = byte(offset);
+	if (lead < 0x80) {
+		offset++;
+		return lead;
+	}
+
+	size_t length;
+	char32_t code_point;
+	if ((lead & 0xE0) == 0xC0) {
+		length = 2;
+		code_point = lead & 0x1F;
+	} else if ((lead & 0xF0) == 0xE0) {
+		length = 3;
+		code_point = lead & 0x0F;
+	} else if ((lead & 0xF8) == 0xF0) {
+		length = 4;
+		code_point = lead & 0x07;
+	} else {
+		offset++;
+		return REPLACEMENT;
+	}
+
+	if (offset + length > text.size()) {
+		offset++;
+		return REPLACEMENT;
+	}
+	for (size_t i = 1; i < length; i++) {
+		if ((byte(offset + i) & 0xC0) != 0x80) {
+			offset++;
+			return REPLACEMENT;
+		}
+		code_point = code_point << 6 | (byte(offset + i) & 0x3F);
+	}
+	offset += length;
+	return code_point;
+}
+
+unsigned utf8::width(const char32_t code_point) {
+	// Latin and most of what the console draws, box drawing and block elements, without a search
+	if (code_point < 0x0300) return 1;
+	if (code_point >= 0x2500 && code_point < 0x25FD) return 1;
+
+	if (contains(ZERO_WIDTH, code_point)) return 0;
+	if (contains(WIDE, code_point)) return 2;
+	return 1;
+}
+
+size_t utf8::width(const std::string_view text) {
+	size_t total = 0;
+	size_t i = 0;
+	while (i < text.size()) {
+#ifdef __SSE2__
+		// Blocks of ASCII and code points below U+0300 are one column per code point
+		while (i + 16 <= text.size()) {
+			const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(text.data() + i));
+			if (wide_leads(bytes)) break;
+			total += std::popcount(static_cast<unsigned>(starts(bytes)));
+			i += 16;
+			while (i < text.size() && continuation(text[i])) i++; // Rest of a code point the block cut apart
+		}
+		if (i >= text.size()) break;
+#endif
+		if (continuation(text[i])) {
+			i++;
+			continue;
+		}
+		total += width(decode(text, i));
+	}
+	return total;
+}
+
+size_t utf8::prefix(const std::string_view text, const size_t max_width) {
+	size_t total = 0;
+	size_t i = 0;
+	while (i < text.size()) {
+		if (continuation(text[i])) {
+			i++;
+			continue;
+		}
+		size_t next = i;
+		const unsigned code_point_width = width(decode(text, next));
+		if (total + code_point_width > max_width) break;
+		total += code_point_width;
+		i = next;
+	}
+	return i;
+}
@@ -0,0 +1,21 @@
+#pragma once
+#include <cstddef>
+#include <string_view>
+
+// UTF-8 measuring for the console and the BlackBoard. Invalid lead bytes and cut off sequences count as one narrow
+// replacement character each, continuation bytes without a lead as nothing.
+namespace utf8 {
+	inline constexpr char32_t REPLACEMENT = U'�';
+
+	// Terminal columns taken by a code point: 0 for combining and zero width characters, 2 for East Asian wide ones
+	// and emoji, 1 for everything else including box drawing
+	[[nodiscard]] unsigned width(char32_t code_point);
+	// Terminal columns taken by the text, blocks of characters that are all one column wide are counted 16 bytes at a time
+	[[nodiscard]] size_t width(std::string_view text);
+
+	// Bytes of the longest prefix no wider than max_width, never cutting a code point apart
+	[[nodiscard]] size_t prefix(std::string_view text, size_t max_width);
+
+	// The code point starting at text[offset], with offset moved past it. offset has to be on a lead byte.
+	[[nodiscard]] char32_t decode(std::string_view text, size_t &offset);
+}
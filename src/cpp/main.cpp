@@ -5,9 +5,17 @@
 #include <fstream>
 #include <iostream>
 #include <map>
+#include <memory>
+#include <optional>
 #include <set>
+#include <string_view>
 
+#include "BlackBoard.h"
+#include "Log.h"
 #include "Renderer.h"
+#include "SceneTransforms.h"
+#include "Trace.h"
+#include "text_formatting.h"
 
 import vulkan_hpp;
 
@@ -753,8 +761,8 @@ namespace raii = vk::raii;
 
 
 
-void start() {
-	Renderer renderer;
+void start(const bool terminal_output) {
+	Renderer renderer{terminal_output};
 
 	renderer.main_loop();
 
@@ -874,10 +882,56 @@ void start() {
 
 
 
-int main() {
+int main(const int argc, char **argv) {
 	try {
-		start();
+		trace::name_thread("Main");
+		bool terminal_output = false;
+		bool log_window = false;
+		std::optional<std::string> log_file;
+		logging::Level log_level = logging::Level::Info;
+		for (int i = 1; i < argc; i++) {
+			const std::string_view argument{argv[i]};
+			if (argument == "--bench-transforms") {
+				benchmark_scene_transforms();
+				return 0;
+			}
+			if (argument == "--bench-blackboard") {
+				benchmark_black_board();
+				return 0;
+			}
+			if (argument == "--terminal") {
+				terminal_output = true;
+			} else if (argument == "--trace") {
+				trace::start();
+			} else if (argument == "--log-window") {
+				log_window = true;
+			} else if (argument == "--verbose") {
+				log_level = logging::Level::Debug;
+			} else if (argument == "--log-file" && i + 1 < argc) {
+				log_file = argv[++i];
+			} else {
+				std::cerr << "Unknown argument " << argument << "\n";
+				return 1;
+			}
+		}
+
+		// The terminal output owns the console, only errors may scroll it
+		logging::Logger &logger = logging::logger();
+		logger.set_level(log_level);
+		if (terminal_output) {
+			logger.add_sink(std::make_unique<logging::ConsoleSink>(logging::Level::Error));
+		} else if (log_window) {
+			logger.add_sink(std::make_unique<logging::WindowSink>("LavaChicken log"));
+		} else {
+			logger.add_sink(std::make_unique<logging::ConsoleSink>(logging::Level::Debug));
+		}
+		if (log_file) logger.add_sink(std::make_unique<logging::FileSink>(*log_file));
+
+		start(terminal_output);
 	} catch (const std::exception& e) {
+		// Also reaches the console when no sink is installed yet, and is not cut to a record's payload
+		wnd::flush(); // What the console showed up to the error
+		logging::logger().flush();
 		std::cerr << e.what() << std::endl;
 		return 1;
 	}
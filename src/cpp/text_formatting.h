@@ -1,41 +1,117 @@
 #pragma once
+#include <algorithm>
 #include <cmath>
-#include <codecvt>
 #include <iostream>
 #include <string>
+#include <string_view>
+#include <vector>
 
+#include "Utf8.h"
+
+// Framed debug console. Everything is formatted into a per-thread buffer that goes out with a single write when a
+// section ends (at the next begin_section(), at end() or flush()), so printing costs no more than an append.
 namespace wnd {
+	namespace detail {
+		// Runs this long are appended with a single copy, longer ones in pieces
+		constexpr unsigned long PRECOMPUTED_RUN = 256;
+
+		// One character repeated, precomputed so borders and padding are a slice of it instead of a loop
+		class Run {
+			std::string_view glyph;
+			std::string text;
+
+		public:
+			explicit Run(const std::string_view _glyph): glyph(_glyph) {
+				text.reserve(glyph.size() * PRECOMPUTED_RUN);
+				for (unsigned long i = 0; i < PRECOMPUTED_RUN; i++) text += glyph;
+			}
+
+			[[nodiscard]] bool of(const std::string_view other) const { return other == glyph; }
+
+			void append(std::string &out, unsigned long n) const {
+				for (; n > PRECOMPUTED_RUN; n -= PRECOMPUTED_RUN) out += text;
+				out.append(text, 0, n * glyph.size());
+			}
+		};
+
+		inline const Run heavy_horizontal{"━"};
+		inline const Run light_horizontal{"─"};
+		inline const Run light_vertical{"│"};
+		inline const Run space{" "};
+		inline const Run dash{"-"};
+
+		inline thread_local std::string buffer;
+	}
+
+	inline void append_repeated(std::string &out, const std::string_view s, const unsigned long n) {
+		for (const detail::Run *run : {&detail::space, &detail::light_horizontal, &detail::dash, &detail::heavy_horizontal, &detail::light_vertical}) {
+			if (run->of(s)) return run->append(out, n);
+		}
+		out.reserve(out.size() + s.size() * n);
+		for (unsigned long i = 0; i < n; i++) out += s;
+	}
+
 	inline std::string operator*(const std::string &s, const unsigned long n) {
 		std::string out;
-		for (unsigned long i = 0; i < n; i++) {
-			out += s;
-		}
+		append_repeated(out, s, n);
 		return out;
 	}
 
-	inline std::string set_length(
-		std::string in,
+	// Appends in padded to n terminal columns, or cut to as many whole characters as fit
+	inline void append_padded(
+		std::string &out,
+		const std::string_view in,
 		const unsigned long n,
-		const std::string &padding = " ",
+		const std::string_view padding = " ",
 		const bool end_with_space = false
 	) {
-		if (end_with_space) {
-			in += " ";
+		const size_t in_width = utf8::width(in);
+		if (in_width + end_with_space <= n) {
+			out += in;
+			if (end_with_space) out += ' ';
+			append_repeated(out, padding, n - in_width - end_with_space);
+			return;
+		}
+
+		// A wide character may not fit into the last column, the padding fills it
+		const std::string_view cut = in.substr(0, utf8::prefix(in, n));
+		out += cut;
+		unsigned long cut_width = utf8::width(cut);
+		if (end_with_space && cut_width < n) {
+			out += ' ';
+			cut_width++;
 		}
-		std::wstring_convert<std::codecvt_utf8<char32_t>, char32_t> converter;
-		const auto utf = converter.from_bytes(in);
-		if (utf.length() <= n) return in + padding * (n - utf.length());
-		return std::string{in.begin(), in.begin() + n};
+		append_repeated(out, padding, n - cut_width);
+	}
+
+	inline std::string set_length(
+		const std::string_view in,
+		const unsigned long n,
+		const std::string_view padding = " ",
+		const bool end_with_space = false
+	) {
+		std::string out;
+		out.reserve(std::max<size_t>(in.size() + 1, n * padding.size()));
+		append_padded(out, in, n, padding, end_with_space);
+		return out;
+	}
+
+	// Writes out what this thread formatted so far
+	inline void flush() {
+		if (detail::buffer.empty()) return;
+		std::cout.write(detail::buffer.data(), static_cast<std::streamsize>(detail::buffer.size()));
+		detail::buffer.clear();
 	}
 
 
 
-	inline unsigned long width = 0;
-	inline unsigned long frame_level = 0;
+	// Every thread draws its own window
+	inline thread_local unsigned long width = 0;
+	inline thread_local unsigned long frame_level = 0;
 
-	inline std::vector<std::vector<std::string>> columns;
-	inline unsigned long current_column;
-	inline unsigned long current_row;
+	inline thread_local std::vector<std::vector<std::string>> columns;
+	inline thread_local unsigned long current_column;
+	inline thread_local unsigned long current_row;
 
 	enum WindowButtons {
 		none = 0,
@@ -45,34 +121,39 @@ namespace wnd {
 		all_buttons = minimise_button | maximise_button | close_button,
 	};
 
-	inline unsigned long begin(const std::string &title, const WindowButtons shown_buttons = none,
+	inline unsigned long begin(const std::string_view title, const WindowButtons shown_buttons = none,
 					  unsigned long new_width = 0) {
+		std::string &out = detail::buffer;
 		if (shown_buttons & minimise_button && new_width >= 4) new_width -= 4;
 		if (shown_buttons & maximise_button && new_width >= 4) new_width -= 4;
 		if (shown_buttons & close_button && new_width >= 4) new_width -= 4;
 
 		new_width = std::max(title.length() + 2, new_width);
-		std::cout << "┏" << std::string{"━"} * new_width;
+		out += "┏";
+		detail::heavy_horizontal.append(out, new_width);
 
-		if (shown_buttons & minimise_button) std::cout << "┯━━━";
-		if (shown_buttons & maximise_button) std::cout << "┯━━━";
-		if (shown_buttons & close_button) std::cout << "┯━━━";
+		if (shown_buttons & minimise_button) out += "┯━━━";
+		if (shown_buttons & maximise_button) out += "┯━━━";
+		if (shown_buttons & close_button) out += "┯━━━";
 
-		std::cout << "┓\n";
-		std::cout << "┃ " << set_length(title, new_width - 2) << " ";
+		out += "┓\n";
+		out += "┃ ";
+		append_padded(out, title, new_width - 2);
+		out += " ";
 
-		if (shown_buttons & minimise_button) std::cout << "│ - ";
-		if (shown_buttons & maximise_button) std::cout << "│ □ ";
-		if (shown_buttons & close_button) std::cout << "│ X ";
+		if (shown_buttons & minimise_button) out += "│ - ";
+		if (shown_buttons & maximise_button) out += "│ □ ";
+		if (shown_buttons & close_button) out += "│ X ";
 
-		std::cout << "┃\n";
-		std::cout << "┣" << std::string{"━"} * new_width;
+		out += "┃\n";
+		out += "┣";
+		detail::heavy_horizontal.append(out, new_width);
 
-		if (shown_buttons & minimise_button) std::cout << "┷━━━";
-		if (shown_buttons & maximise_button) std::cout << "┷━━━";
-		if (shown_buttons & close_button) std::cout << "┷━━━";
+		if (shown_buttons & minimise_button) out += "┷━━━";
+		if (shown_buttons & maximise_button) out += "┷━━━";
+		if (shown_buttons & close_button) out += "┷━━━";
 
-		std::cout << "┫\n";
+		out += "┫\n";
 
 		if (shown_buttons & minimise_button) new_width += 4;
 		if (shown_buttons & maximise_button) new_width += 4;
@@ -84,12 +165,17 @@ namespace wnd {
 		return new_width;
 	}
 
-	inline void begin_section(const std::string &title) {
-		std::cout << "┠─ " << set_length(title, width - 3, "─", true) << "─┨\n";
+	// Also flushes the previous section
+	inline void begin_section(const std::string_view title) {
+		flush();
+		std::string &out = detail::buffer;
+		out += "┠─ ";
+		append_padded(out, title, width - 3, "─", true);
+		out += "─┨\n";
 		frame_level = 0;
 	}
 
-	inline void print(const std::string &string = "") {
+	inline void print(const std::string_view string = "") {
 		if (current_column) {
 			current_row++;
 			while (columns.size() <= current_row) columns.emplace_back();
@@ -100,25 +186,31 @@ namespace wnd {
 			return;
 		}
 
-		std::cout << "┃";
-		std::cout << std::string{"│"} * frame_level;
-		std::cout << " " << set_length(string, width - frame_level * 2 - 2) << " ";
-		std::cout << std::string{"│"} * frame_level;
-		std::cout << "┃\n";
+		std::string &out = detail::buffer;
+		out += "┃";
+		detail::light_vertical.append(out, frame_level);
+		out += " ";
+		append_padded(out, string, width - frame_level * 2 - 2);
+		out += " ";
+		detail::light_vertical.append(out, frame_level);
+		out += "┃\n";
 	}
 
-	inline void begin_frame(const std::string &contents = "") {
-		std::cout << "┃";
-		std::cout << std::string{"│"} * frame_level;
+	inline void begin_frame(const std::string_view contents = "") {
+		std::string &out = detail::buffer;
+		out += "┃";
+		detail::light_vertical.append(out, frame_level);
 		if (contents.empty()) {
-			std::cout << "┌" << std::string{"─"} * (width - 2 - frame_level * 2) << "┐";
+			out += "┌";
+			detail::light_horizontal.append(out, width - 2 - frame_level * 2);
+			out += "┐";
 		} else {
-			std::cout << "┌─ ";
-			std::cout << set_length(contents, width - 5 - frame_level * 2, "─", true);
-			std::cout << "─┐";
+			out += "┌─ ";
+			append_padded(out, contents, width - 5 - frame_level * 2, "─", true);
+			out += "─┐";
 		}
-		std::cout << std::string{"│"} * frame_level;
-		std::cout << "┃\n";
+		detail::light_vertical.append(out, frame_level);
+		out += "┃\n";
 		frame_level++;
 	}
 
@@ -126,16 +218,23 @@ namespace wnd {
 		if (frame_level == 0) return;
 		frame_level--;
 
-		std::cout << "┃";
-		std::cout << std::string{"│"} * frame_level;
-		std::cout << "└" << std::string{"─"} * (width - 2 - frame_level * 2) << "┘";
-		std::cout << std::string{"│"} * frame_level;
-		std::cout << "┃\n";
+		std::string &out = detail::buffer;
+		out += "┃";
+		detail::light_vertical.append(out, frame_level);
+		out += "└";
+		detail::light_horizontal.append(out, width - 2 - frame_level * 2);
+		out += "┘";
+		detail::light_vertical.append(out, frame_level);
+		out += "┃\n";
 	}
 
 	inline void end() {
-		std::cout << "┗" << std::string{"━"} * width << "┛\n";
+		std::string &out = detail::buffer;
+		out += "┗";
+		detail::heavy_horizontal.append(out, width);
+		out += "┛\n";
 		frame_level = 0;
+		flush();
 	}
 
 	inline void flush_columns(const bool framed = false, const bool fit_to_width = true) {
@@ -145,10 +244,10 @@ namespace wnd {
 		std::vector<unsigned long> column_max_width;
 
 		for (const std::vector<std::string> &row : columns) {
-			int i = 0;
+			size_t i = 0;
 			for (const std::string &column : row) {
 				while (column_max_width.size() <= i) column_max_width.emplace_back();
-				if (column.length() > column_max_width[i]) column_max_width[i] = column.length();
+				column_max_width[i] = std::max<unsigned long>(column_max_width[i], utf8::width(column));
 				i++;
 			}
 		}
@@ -163,34 +262,41 @@ namespace wnd {
 			/ column_max_width.size() * column_max_width.size();
 		}
 
-		if (framed) {
-			std::cout << "┃";
-			std::cout << std::string{"│"} * frame_level;
-			std::cout << "┌";
+		// Top or bottom border of the table, with a tee between columns
+		const auto border = [&](const char *left, const char *tee, const char *right) {
+			std::string &out = detail::buffer;
+			out += "┃";
+			detail::light_vertical.append(out, frame_level);
+			out += left;
 			unsigned long i = column_max_width.size() - 1;
 			unsigned long total_width = width - 2;
 			for (const unsigned long &length: column_max_width) {
-				std::cout << std::string{"─"} * (length + (i ? 2 : 0));
+				detail::light_horizontal.append(out, length + (i ? 2 : 0));
 				total_width -= length + (i ? 3 : 0);
-				if (i--) std::cout << "┬";
+				if (i--) out += tee;
 			}
 			total_width -= frame_level * 2;
-			if (!fit_to_width) std::cout << std::string{"─"} * total_width;
-			std::cout << "┐";
-			std::cout << std::string{"│"} * frame_level;
-			std::cout << "┃\n";
+			if (!fit_to_width) detail::light_horizontal.append(out, total_width);
+			out += right;
+			detail::light_vertical.append(out, frame_level);
+			out += "┃\n";
+		};
+
+		if (framed) {
+			border("┌", "┬", "┐");
 			frame_level++;
 		}
 
+		static thread_local std::string row_string;
 		for (const std::vector<std::string> &row : columns) {
-			std::string row_string;
+			row_string.clear();
 			bool first = true;
-			int i = 0;
+			size_t i = 0;
 			for (const std::string& column : row) {
 				if (!first) row_string += " ";
-				if (!first && framed) row_string += std::string{"│ "};
+				if (!first && framed) row_string += "│ ";
 				first = false;
-				row_string += set_length(column, column_max_width[i++], "-");
+				append_padded(row_string, column, column_max_width[i++], "-");
 			}
 			print(row_string);
 		}
@@ -198,21 +304,7 @@ namespace wnd {
 
 		if (framed) {
 			frame_level--;
-			std::cout << "┃";
-			std::cout << std::string{"│"} * frame_level;
-			std::cout << "└";
-			unsigned long i = column_max_width.size() - 1;
-			unsigned long total_width = width - 2;
-			for (const unsigned long &length: column_max_width) {
-				std::cout << std::string{"─"} * (length + (i ? 2 : 0));
-				total_width -= length + (i ? 3 : 0);
-				if (i--) std::cout << "┴";
-			}
-			total_width -= frame_level * 2;
-			if (!fit_to_width) std::cout << std::string{"─"} * total_width;
-			std::cout << "┘";
-			std::cout << std::string{"│"} * frame_level;
-			std::cout << "┃\n";
+			border("└", "┴", "┘");
 		}
 	}
 
@@ -221,7 +313,7 @@ namespace wnd {
 		current_row = -1;
 	}
 
-	inline void vertical_print(const std::string& string) {
+	inline void vertical_print(const std::string_view string) {
 		for (const char &e: string) {
 			print({&e, 1});
 		}